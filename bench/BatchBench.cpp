@@ -0,0 +1,94 @@
+#include "BatchConverter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Skewed corpus: a few large karaoke-style ASS scripts among many small SRT files.
+// Usage: batch_bench [large MB] [small files] [threads]
+namespace
+{
+void writeLarge(const std::string& path, size_t bytes)
+{
+	std::ofstream out(path);
+	out << "[Script Info]\nScriptType: v4.00+\n\n[V4+ Styles]\nFormat: Name, Fontname, Fontsize\n"
+		   "Style: Karaoke,Arial,28\n\n[Events]\n";
+	char line[160];
+	size_t written = 0;
+	for (long i = 0; written < bytes; ++i)
+	{
+		const long ms = i * 37 % 3600000;
+		const int n = std::snprintf(line, sizeof line,
+									"Dialogue: %ld,%ld:%02ld:%02ld.%02ld,%ld:%02ld:%02ld.%02ld,Karaoke,,0,0,0,,{\\k20}La {\\k30}la %ld\n",
+									i % 3, ms / 3600000, ms / 60000 % 60, ms / 1000 % 60, ms / 10 % 100, ms / 3600000,
+									ms / 60000 % 60, (ms / 1000 + 2) % 60, ms / 10 % 100, i);
+		out.write(line, n);
+		written += n;
+	}
+}
+
+void writeSmall(const std::string& path, int cues)
+{
+	std::ofstream out(path);
+	for (int i = 0; i < cues; ++i)
+	{
+		out << i + 1 << "\n00:" << (i / 60 % 60 < 10 ? "0" : "") << i / 60 % 60 << ":" << (i % 60 < 10 ? "0" : "")
+			<< i % 60 << ",000 --> 00:" << (i / 60 % 60 < 10 ? "0" : "") << i / 60 % 60 << ":"
+			<< (i % 60 < 10 ? "0" : "") << i % 60 << ",900\nSmall file line " << i << "\n\n";
+	}
+}
+
+void report(const char* name, BatchConverter& converter, const std::vector< ConversionJob >& jobs)
+{
+	const auto begin = std::chrono::steady_clock::now();
+	const int converted = converter.convert(jobs);
+	const double wall = std::chrono::duration< double >(std::chrono::steady_clock::now() - begin).count();
+
+	const auto stats = converter.getScheduler().getStats();
+	double busy = 0;
+	std::printf("%s: %d/%zu files in %.2f s\n", name, converted, jobs.size(), wall);
+	for (size_t w = 0; w < stats.size(); ++w)
+	{
+		busy += stats[w].busySeconds;
+		std::printf("  worker %zu: %5zu tasks, %4zu steals, busy %5.1f%%\n", w, stats[w].tasks, stats[w].steals,
+					100.0 * stats[w].busySeconds / wall);
+	}
+	std::printf("  core utilization %.1f%%\n", 100.0 * busy / (wall * stats.size()));
+}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t largeBytes = (size_t)(argc > 1 ? std::atoi(argv[1]) : 64) << 20;
+	const int smallFiles = argc > 2 ? std::atoi(argv[2]) : 2000;
+	const unsigned threads = argc > 3 ? (unsigned)std::atoi(argv[3]) : 0;
+
+	std::vector< ConversionJob > jobs;
+	for (int i = 0; i < 3; ++i)
+	{
+		const std::string path = "bench_large_" + std::to_string(i) + ".ass";
+		writeLarge(path, largeBytes);
+		jobs.push_back({ path, path + ".srt" });
+	}
+	for (int i = 0; i < smallFiles; ++i)
+	{
+		const std::string path = "bench_small_" + std::to_string(i) + ".srt";
+		writeSmall(path, 400);
+		jobs.push_back({ path, path + ".ass" });
+	}
+
+	BatchConverter partitioned(threads, (size_t)-1, false);
+	report("static partitioning, whole files", partitioned, jobs);
+	BatchConverter stealing(threads);
+	report("work stealing, 4 MiB chunks", stealing, jobs);
+
+	for (const auto& job : jobs)
+	{
+		std::remove(job.input.c_str());
+		std::remove(job.output.c_str());
+	}
+	return 0;
+}
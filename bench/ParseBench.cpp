@@ -0,0 +1,73 @@
+#include "SRT.h"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <string>
+
+// Parses one SRT document with and without the cue pre-scan, reporting heap allocations and peak RSS.
+// Run each mode in its own process: ru_maxrss never goes down.
+namespace
+{
+size_t allocations = 0;
+
+class GrowingSRT : public SRT
+{
+protected:
+	size_t estimateCues(const std::string &) const override { return 0; }
+};
+
+std::string makeDocument(int count)
+{
+	std::ostringstream out;
+	for (int i = 0; i < count; ++i)
+	{
+		const int start = i * 2, end = start + 1;
+		out << i + 1 << "\n";
+		out << "00:" << (start / 60) % 60 / 10 << (start / 60) % 10 << ":" << start % 60 / 10 << start % 10
+			<< ",000 --> 00:" << (end / 60) % 60 / 10 << (end / 60) % 10 << ":" << end % 60 / 10 << end % 10
+			<< ",500\n";
+		out << "Some dialogue for cue " << i << "\nAnd a second line\n\n";
+	}
+	return out.str();
+}
+}
+
+// Out of line so the compiler does not pair the inlined malloc/free with new/delete.
+__attribute__((noinline)) void *operator new(size_t size)
+{
+	++allocations;
+	if (void *p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t) noexcept { ::operator delete(p); }
+
+int main(int argc, char **argv)
+{
+	const bool grow = argc > 1 && std::strcmp(argv[1], "grow") == 0;
+	const int count = argc > 2 ? std::atoi(argv[2]) : 200000;
+	const std::string document = makeDocument(count);
+
+	std::unique_ptr< SRT > sub(grow ? new GrowingSRT() : new SRT());
+	std::istringstream in(document);
+	const size_t before = allocations;
+	const auto begin = std::chrono::steady_clock::now();
+	sub->fileParse(in);
+	const double ms = std::chrono::duration< double, std::milli >(std::chrono::steady_clock::now() - begin).count();
+
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	std::printf("%s: %d cues in %.1f ms, %zu allocations, %d arena blocks, peak RSS %ld KiB\n",
+				grow ? "grow" : "presized", sub->getContents().size(), ms, allocations - before,
+				(int)sub->getArena().blockCount(), usage.ru_maxrss);
+	return sub->getContents().size() == count ? 0 : 1;
+}
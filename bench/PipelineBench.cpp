@@ -0,0 +1,78 @@
+#include "Transform.h"
+#include "WriteBehavior.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <string>
+
+// Compares strip + shift + filter + write as separate passes against one fused Pipeline write. Both
+// strip with TextTransform's scanner, so the difference is the extra passes and copies alone.
+namespace
+{
+const Structures::Ticks shiftBy = 1500;
+const Structures::Ticks rangeFrom = 60000;
+
+DynamicArray< Structures::Node > makeCues(int count)
+{
+	DynamicArray< Structures::Node > nodes;
+	for (int i = 0; i < count; ++i)
+	{
+		const Structures::Ticks start = (Structures::Ticks)i * 2000;
+		const char *text = i % 10 == 0 ? "{\\an8}" : "<i>Some dialogue</i> with {\\b1}tags{\\b0}";
+		nodes.push_back(Structures::Node({ 0, start, start + 1800 }, text));
+	}
+	return nodes;
+}
+
+template < typename F > double millis(F f)
+{
+	const auto begin = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration< double, std::milli >(std::chrono::steady_clock::now() - begin).count();
+}
+}
+
+int main(int argc, char **argv)
+{
+	const int count = argc > 1 ? std::atoi(argv[1]) : 200000;
+	const DynamicArray< Structures::Node > cues = makeCues(count);
+	toSRT writer;
+	size_t sequentialBytes = 0, fusedBytes = 0;
+
+	const double sequential = millis([&]() {
+		DynamicArray< Structures::Node > nodes = cues;
+		TextTransform strip;
+		strip.strip(TextTransform::BracesAndTags);
+		for (auto &node : nodes)
+			node.dialogue = strip.apply(node.dialogue);
+		for (auto &node : nodes)
+		{
+			node.time.start += shiftBy;
+			node.time.end += shiftBy;
+		}
+		DynamicArray< Structures::Node > kept;
+		for (const auto &node : nodes)
+		{
+			if (!node.dialogue.empty() && node.time.end > rangeFrom)
+				kept.push_back(node);
+		}
+		std::ostringstream out;
+		writer.write(out, kept);
+		sequentialBytes = out.str().size();
+	});
+
+	const double fused = millis([&]() {
+		Pipeline pipeline;
+		pipeline.strip(TextTransform::BracesAndTags).shift(shiftBy).between(rangeFrom, std::numeric_limits< Structures::Ticks >::max()).dropEmpty();
+		std::ostringstream out;
+		writer.write(out, cues, Structures::StyleSheet(), pipeline);
+		fusedBytes = out.str().size();
+	});
+
+	std::printf("%d cues: sequential %.1f ms, fused %.1f ms (%zu / %zu bytes)\n", count, sequential, fused,
+				sequentialBytes, fusedBytes);
+	return sequentialBytes == fusedBytes ? 0 : 1;
+}
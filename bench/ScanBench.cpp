@@ -0,0 +1,103 @@
+#include "Scanner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Byte scanning throughput of the Scanner kernels against a byte-at-a-time loop over an SRT-like
+// buffer: newline count, " --> " search and line splitting. The scan_bench_sse2 target is the same
+// program with AVX2 disabled, so both SIMD kernels can be compared on one machine.
+namespace
+{
+std::string makeDocument(size_t bytes)
+{
+	std::string text;
+	text.reserve(bytes + 128);
+	for (int i = 1; text.size() < bytes; ++i)
+		text += std::to_string(i) + "\n00:00:01,000 --> 00:00:02,000\nSome dialogue for this cue\nAnd a second line\n\n";
+	return text;
+}
+
+size_t scalarCount(const char *p, size_t n, char c)
+{
+	size_t hits = 0;
+	for (size_t i = 0; i < n; ++i)
+		hits += p[i] == c;
+	return hits;
+}
+
+size_t scalarFind(const char *p, size_t n, const char *needle, size_t length)
+{
+	for (size_t i = 0; i + length <= n; ++i)
+	{
+		if (p[i] == needle[0] && std::memcmp(p + i + 1, needle + 1, length - 1) == 0)
+			return i;
+	}
+	return n;
+}
+
+size_t scalarLines(const char *p, size_t n)
+{
+	size_t lines = 0;
+	for (size_t pos = 0; pos < n; ++lines)
+	{
+		size_t end = pos;
+		while (end < n && p[end] != '\n')
+			++end;
+		pos = end + 1;
+	}
+	return lines;
+}
+
+size_t scannerLines(const char *p, size_t n)
+{
+	Scanner::LineCursor cursor(p, n);
+	const char *line;
+	size_t length, lines = 0;
+	while (cursor.next(line, length))
+		++lines;
+	return lines;
+}
+
+// Best of several runs, in GB/s; sink keeps the result alive.
+template < typename F > double throughput(size_t bytes, int runs, size_t &sink, F f)
+{
+	double best = 1e30;
+	for (int r = 0; r < runs; ++r)
+	{
+		const auto begin = std::chrono::steady_clock::now();
+		sink += f();
+		best = std::min(best, std::chrono::duration< double >(std::chrono::steady_clock::now() - begin).count());
+	}
+	return bytes / best / 1e9;
+}
+}
+
+int main(int argc, char **argv)
+{
+	const size_t bytes = (argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64) << 20;
+	const std::string text = makeDocument(bytes);
+	const char *p = text.data();
+	const size_t n = text.size();
+	size_t sink = 0;
+
+	// Searching for a needle that never occurs walks the whole buffer.
+	const char missing[] = " --> 99";
+	const double countScalar = throughput(n, 5, sink, [&]() { return scalarCount(p, n, '\n'); });
+	const double countSimd = throughput(n, 5, sink, [&]() { return Scanner::count(p, n, '\n'); });
+	const double findScalar = throughput(n, 5, sink, [&]() { return scalarFind(p, n, missing, 7); });
+	const double findSimd = throughput(n, 5, sink, [&]() { return Scanner::find(p, n, missing, 7); });
+	const double linesScalar = throughput(n, 5, sink, [&]() { return scalarLines(p, n); });
+	const double linesSimd = throughput(n, 5, sink, [&]() { return scannerLines(p, n); });
+
+	std::printf("%zu MiB, kernel %s (GB/s, scalar / simd)\n", n >> 20, Scanner::implementation());
+	std::printf("count '\\n'   %6.2f / %6.2f\n", countScalar, countSimd);
+	std::printf("find needle  %6.2f / %6.2f\n", findScalar, findSimd);
+	std::printf("split lines  %6.2f / %6.2f\n", linesScalar, linesSimd);
+	const bool same = scalarCount(p, n, '\n') == Scanner::count(p, n, '\n') &&
+					  scalarLines(p, n) == scannerLines(p, n) && Scanner::find(p, n, missing, 7) == n;
+	return same && sink ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+#include "SRT.h"
+#include "Segmenter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+// Segments a three-hour programme into 6 s WebVTT segments in one pass, against re-parsing the
+// whole SRT file and filtering it once per segment.
+namespace
+{
+const Structures::Ticks programme = 3 * 3600 * 1000;
+const Structures::Ticks segmentLength = 6000;
+
+std::string makeProgramme(Structures::Ticks spacing)
+{
+	std::ostringstream out;
+	toSRT writer;
+	DynamicArray< Structures::Node > nodes;
+	for (Structures::Ticks start = 0; start < programme; start += spacing)
+		nodes.push_back(Structures::Node({ 0, start, start + spacing * 5 / 4 }, "Some dialogue\nAnd a second line"));
+	writer.write(out, nodes);
+	return out.str();
+}
+
+template < typename F > double millis(F f)
+{
+	const auto begin = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration< double, std::milli >(std::chrono::steady_clock::now() - begin).count();
+}
+}
+
+int main(int argc, char **argv)
+{
+	const Structures::Ticks spacing = argc > 1 ? std::atoi(argv[1]) : 2000;
+	const std::string document = makeProgramme(spacing);
+	toVTT writer;
+	size_t onePassBytes = 0, rescanBytes = 0, segments = 0;
+
+	const double onePass = millis([&]() {
+		SRT sub;
+		std::istringstream in(document);
+		sub.fileParse(in);
+		sub.normalize();
+		Segmenter segmenter(writer, segmentLength,
+							[&](size_t, Structures::Ticks, const std::string &segment) { onePassBytes += segment.size(); });
+		segmenter.push(sub.getContents());
+		segments = segmenter.finish();
+	});
+
+	const double rescan = millis([&]() {
+		for (size_t index = 0; index < segments; ++index)
+		{
+			const Structures::Ticks from = index * segmentLength, to = from + segmentLength;
+			SRT sub;
+			std::istringstream in(document);
+			sub.fileParse(in);
+			DynamicArray< Structures::Node > window;
+			for (const auto &node : sub.getContents())
+			{
+				if (node.time.start < to && std::max(node.time.end, node.time.start + 1) > from)
+					window.push_back(node);
+			}
+			rescanBytes += writer.writeToString(window).size();
+		}
+	});
+
+	std::printf("3 h programme, %zu KB SRT, %zu segments: one pass %.1f ms, parse per segment %.1f ms (%zu / %zu bytes)\n",
+				document.size() >> 10, segments, onePass, rescan, onePassBytes, rescanBytes);
+	return onePassBytes == rescanBytes ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+#include "SubtitleFactory.h"
+#include "Transcode.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+// Converts generated documents through parse + normalize + write and through the fast path; a plain
+// copy of the SRT input gives the memcpy baseline.
+namespace
+{
+// Cues are 600 ms apart, so even large counts stay below the 100 hours SRT clocks can hold.
+std::string clock(int ms, char separator, bool srt)
+{
+	char buffer[32];
+	const int seconds = ms / 1000;
+	if (srt)
+		std::snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d%c%03d", seconds / 3600, seconds / 60 % 60, seconds % 60,
+					  separator, ms % 1000);
+	else
+		std::snprintf(buffer, sizeof(buffer), "%d:%02d:%02d%c%02d", seconds / 3600, seconds / 60 % 60, seconds % 60,
+					  separator, ms % 1000 / 10);
+	return buffer;
+}
+
+std::string makeSRT(int count)
+{
+	std::ostringstream out;
+	for (int i = 0; i < count; ++i)
+		out << i + 1 << "\n"
+			<< clock(i * 600, ',', true) << " --> " << clock(i * 600 + 500, ',', true) << "\nSome dialogue for cue " << i
+			<< "\nAnd a second line\n\n";
+	return out.str();
+}
+
+std::string makeSSA(int count)
+{
+	std::ostringstream out;
+	out << "[Script Info]\nScriptType: v4.00+\n\n[V4+ Styles]\nFormat: Name, Fontname\nStyle: Default,Arial\n\n[Events]\n"
+		<< "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n";
+	for (int i = 0; i < count; ++i)
+		out << "Dialogue: 0," << clock(i * 600, '.', false) << "," << clock(i * 600 + 500, '.', false)
+			<< ",Default,,0,0,0,,Some dialogue for cue " << i << "\\NAnd a second line\n";
+	return out.str();
+}
+
+std::string makeVTT(int count)
+{
+	std::ostringstream out;
+	out << "WEBVTT\n\n";
+	for (int i = 0; i < count; ++i)
+		out << clock(i * 600, '.', true) << " --> " << clock(i * 600 + 500, '.', true)
+			<< " align:center\nSome dialogue for cue " << i << "\nAnd a second line\n\n";
+	return out.str();
+}
+
+template < typename F > double millis(F f)
+{
+	const auto begin = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration< double, std::milli >(std::chrono::steady_clock::now() - begin).count();
+}
+
+int compare(const char *name, const std::string &input, const std::string &from, const std::string &to)
+{
+	std::string generic, direct;
+	const double slow = millis([&]() {
+		std::unique_ptr< Subtitle > sub = SubtitleFactory::create(from);
+		std::istringstream in(input);
+		sub->fileParse(in);
+		sub->normalize();
+		generic = SubtitleFactory::find(to)->makeWriter()->writeToString(sub->getContents(), sub->getStyles());
+	});
+	bool taken = false;
+	const double fast = millis([&]() {
+		taken = Transcode::find(SubtitleFactory::find(from), SubtitleFactory::find(to))(input, direct);
+	});
+	std::printf("%s, %zu MB: generic %.1f ms (%.0f MB/s), direct %.1f ms (%.0f MB/s)\n", name, input.size() >> 20, slow,
+				input.size() / slow / 1000, fast, input.size() / fast / 1000);
+	return taken && direct == generic ? 0 : 1;
+}
+}
+
+int main(int argc, char **argv)
+{
+	const int count = argc > 1 ? std::atoi(argv[1]) : 500000;
+	const std::string srt = makeSRT(count);
+	std::string copy;
+	const double copied = millis([&]() { copy = srt; });
+	std::printf("copy, %zu MB: %.1f ms (%.0f MB/s)\n", srt.size() >> 20, copied, srt.size() / copied / 1000);
+	return compare("SRT -> TTML", srt, ".srt", ".ttml") | compare("SRT -> VTT", srt, ".srt", ".vtt") |
+		   compare("VTT -> SRT", makeVTT(count), ".vtt", ".srt") | compare("SSA -> SRT", makeSSA(count), ".ass", ".srt");
+}
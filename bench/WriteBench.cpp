@@ -0,0 +1,64 @@
+#include "Scheduler.h"
+#include "WriteBehavior.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+// Writes the same cues as SRT sequentially and with writeParallel on 1..N workers.
+namespace
+{
+DynamicArray< Structures::Node > makeCues(int count)
+{
+	DynamicArray< Structures::Node > nodes;
+	nodes.reserve(count);
+	for (int i = 0; i < count; ++i)
+	{
+		const Structures::Ticks start = (Structures::Ticks)i * 2000;
+		nodes.push_back(Structures::Node({ 0, start, start + 1800 }, "<i>Some dialogue</i> with a second clause"));
+	}
+	return nodes;
+}
+
+template < typename F > double millis(F f)
+{
+	const auto begin = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration< double, std::milli >(std::chrono::steady_clock::now() - begin).count();
+}
+}
+
+int main(int argc, char **argv)
+{
+	const int count = argc > 1 ? std::atoi(argv[1]) : 1000000;
+	const unsigned maxThreads = argc > 2 ? (unsigned)std::atoi(argv[2]) : 8;
+	const DynamicArray< Structures::Node > cues = makeCues(count);
+	Pipeline pipeline;
+	pipeline.strip(TextTransform::BracesAndTags);
+	toSRT writer;
+
+	std::string expected;
+	const double sequential = millis([&]() {
+		std::ostringstream out;
+		writer.write(out, cues, Structures::StyleSheet(), pipeline);
+		expected = out.str();
+	});
+	std::printf("%d cues, %zu bytes: sequential %.1f ms\n", count, expected.size(), sequential);
+
+	int status = 0;
+	for (unsigned threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		WorkStealingScheduler scheduler(threads);
+		std::string written;
+		const double parallel = millis([&]() {
+			std::ostringstream out;
+			writer.writeParallel(out, cues, Structures::StyleSheet(), pipeline, scheduler);
+			written = out.str();
+		});
+		std::printf("  %u threads: %.1f ms (%.2fx)\n", threads, parallel, sequential / parallel);
+		status |= written != expected;
+	}
+	return status;
+}
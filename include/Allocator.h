@@ -0,0 +1,89 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Memory resource behind a DynamicArray, chosen at run time like std::pmr::memory_resource.
+class Allocator
+{
+public:
+  virtual void* allocate(size_t bytes, size_t alignment) = 0;
+  virtual void deallocate(void* p, size_t bytes, size_t alignment) = 0;
+  virtual ~Allocator() = default;
+
+  // Plain operator new/delete; used whenever no allocator is given.
+  static Allocator* standard();
+};
+
+// Bump allocator: deallocate is a no-op and everything is returned at once by release()
+// or the destructor. Blocks double in size, so n bytes take O(log n) upstream calls.
+// Not thread-safe.
+class MonotonicArena : public Allocator
+{
+private:
+  Allocator* upstream;
+  std::vector< std::pair< void*, size_t > > blocks;
+  char* cursor = nullptr;
+  size_t left = 0;
+  size_t nextBlock;
+  size_t reserved = 0;
+
+public:
+  explicit MonotonicArena(size_t initialBlock = 4096, Allocator* upstream = Allocator::standard());
+  ~MonotonicArena() override;
+
+  MonotonicArena(const MonotonicArena&) = delete;
+  MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+  void* allocate(size_t bytes, size_t alignment) override;
+  void deallocate(void*, size_t, size_t) override {}
+
+  // Makes the next bytes of allocations come from one block.
+  void reserve(size_t bytes);
+  void release();
+  size_t blockCount() const { return blocks.size(); }
+  // Bytes taken from upstream and not yet released.
+  size_t bytesReserved() const { return reserved; }
+};
+
+// Free lists for power-of-two size classes from 16 bytes to 512 KiB; freed blocks are
+// reused by later requests of the same class and larger requests go straight upstream.
+// Thread-safe.
+class PoolAllocator : public Allocator
+{
+private:
+  static const int classCount = 16;
+  static const size_t smallest = 16;
+
+  struct FreeBlock
+  {
+    FreeBlock* next;
+  };
+
+  Allocator* upstream;
+  FreeBlock* freeLists[classCount] = {};
+  std::vector< std::pair< void*, size_t > > slabs;
+  std::mutex lock;
+
+  static int classOf(size_t bytes);
+
+public:
+  explicit PoolAllocator(Allocator* upstream = Allocator::standard());
+  ~PoolAllocator() override;
+
+  PoolAllocator(const PoolAllocator&) = delete;
+  PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+  void* allocate(size_t bytes, size_t alignment) override;
+  void deallocate(void* p, size_t bytes, size_t alignment) override;
+
+  size_t slabCount();
+
+  // Process-wide pool for arrays that may outlive the object that built them.
+  static PoolAllocator& shared();
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef BATCHCONVERTER_H
+#define BATCHCONVERTER_H
+
+#include "Scheduler.h"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ConversionJob
+{
+  std::string input;
+  std::string output;
+};
+
+// Converts many files on a work-stealing pool. Formats come from the file extensions.
+// A file larger than the chunk size is parsed as several chunk tasks, merged, and written as
+// one range task per chunk whose buffers are saved in order; smaller files are converted by a
+// single task. A job fails when any step, the final write or the close included, fails.
+class BatchConverter
+{
+private:
+  struct Document;
+
+  size_t chunkSize;
+
+  std::mutex failureLock;
+  std::vector< std::string > failures;
+
+  // Last, so its workers are joined before anything they use is destroyed.
+  WorkStealingScheduler scheduler;
+
+  void open(const ConversionJob& job);
+  void finish(const std::shared_ptr< Document >& doc);
+  void writePiece(const std::shared_ptr< Document >& doc, int range);
+  void save(const std::shared_ptr< Document >& doc);
+  void fail(const std::string& path);
+
+public:
+  explicit BatchConverter(unsigned threads = 0, size_t chunkBytes = 4 << 20, bool stealing = true);
+
+  // Returns how many jobs were written; the inputs of the others are in getFailures().
+  int convert(const std::vector< ConversionJob >& jobs);
+
+  const std::vector< std::string >& getFailures() const { return failures; }
+  const WorkStealingScheduler& getScheduler() const { return scheduler; }
+};
+
+#endif
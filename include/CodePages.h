@@ -0,0 +1,19 @@
+#ifndef CODEPAGES_H
+#define CODEPAGES_H
+
+#include <cstdint>
+
+namespace CodePages
+{
+// Code points for bytes 0x80-0xFF.
+extern const uint16_t cp1252[128];
+extern const uint16_t cp1251[128];
+
+// Indexed by (lead - 0x81) * 190 + (trail - 0x41).
+const int cp949LeadFirst = 0x81;
+const int cp949TrailFirst = 0x41;
+const int cp949TrailCount = 0xFE - 0x41 + 1;
+extern const uint16_t cp949[(0xFE - 0x81 + 1) * (0xFE - 0x41 + 1)];
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef COLLISIONTRACKER_H
+#define COLLISIONTRACKER_H
+
+#include "DynamicArray.h"
+#include "Structures.h"
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+class CollisionTracker
+{
+  private:
+	struct Entry
+	{
+		Structures::Time time;
+		unsigned priority = 0;
+		int left = -1;
+		int right = -1;
+		int parent = -1;
+		Structures::Ticks maxEnd = 0;
+		// Shift not yet passed on to the subtrees; time and maxEnd already include it.
+		Structures::Ticks lazy = 0;
+		bool alive = false;
+	};
+
+	std::vector< Entry > entries;
+	std::vector< std::set< int > > neighbours;
+	std::map< int, int > roots;
+	std::set< std::pair< int, int > > collisions;
+	unsigned seed = 2463534242u;
+
+	unsigned nextPriority();
+	bool less(int a, int b) const;
+	void update(int t);
+	void apply(int t, Structures::Ticks delta);
+	void push(int t);
+	int rooted(int t);
+	void setRoot(int layer, int t);
+	void split(int t, int key, int &l, int &r);
+	void splitStart(int t, Structures::Ticks start, int &l, int &r);
+	int merge(int l, int r);
+	int unite(int a, int b);
+	Structures::Time trueTime(int id) const;
+	void attach(int id);
+	void detach(int id);
+	void link(int a, int b);
+	void unlink(int id);
+	void connect(int id);
+	void overlapping(int t, const Structures::Time &q, int id, Structures::Ticks offset, DynamicArray< int > &out) const;
+
+  public:
+	CollisionTracker() = default;
+	explicit CollisionTracker(const DynamicArray< Structures::Node > &nodes);
+
+	int insert(const Structures::Time &t);
+	void erase(int id);
+	void shift(int id, Structures::Ticks delta);
+	// Moves every cue starting in [from, to) by delta. The block is cut out of the treap, shifted
+	// through a lazy offset and joined back, so pairs inside it are kept as they are; only cues
+	// spanning from or to and cues overlapping the block's new span are queried again.
+	void shiftRange(Structures::Ticks from, Structures::Ticks to, Structures::Ticks delta);
+
+	bool contains(int id) const { return id >= 0 && id < (int)entries.size() && entries[id].alive; }
+	Structures::Time getTime(int id) const { return trueTime(id); }
+	bool collides(int a, int b) const;
+	int count() const { return (int)collisions.size(); }
+	const std::set< std::pair< int, int > > &getPairs() const { return collisions; }
+};
+
+#endif
@@ -1,6 +1,10 @@
 #ifndef DYNAMIC_ARRAY_H
 #define DYNAMIC_ARRAY_H
+#include "Allocator.h"
+
 #include <initializer_list>
+#include <new>
+#include <utility>
 template< typename T >
 class DynamicArray
 {
@@ -8,50 +12,151 @@ private:
   T* data;
   int _size;
   int _capacity;
+  Allocator* alloc;
+
+  T* allocate(int n) { return static_cast< T* >(alloc->allocate(n * sizeof(T), alignof(T))); }
 
-  void resize(int newCapacity)
+  void destroy()
   {
-    T* newData = new T[newCapacity];
     for (int i = 0; i < _size; ++i)
     {
-      newData[i] = data[i];
+      data[i].~T();
     }
-    delete[] data;
+    if (data)
+      alloc->deallocate(data, _capacity * sizeof(T), alignof(T));
+  }
+
+  // Moves the elements into newData, which may already hold a constructed element at _size.
+  void adopt(T* newData, int newCapacity)
+  {
+    for (int i = 0; i < _size; ++i)
+    {
+      new (newData + i) T(std::move(data[i]));
+    }
+    destroy();
     data = newData;
     _capacity = newCapacity;
   }
 
+  void resize(int newCapacity) { adopt(allocate(newCapacity), newCapacity); }
+
+  int grown() const { return _capacity > 0 ? _capacity * 2 : 4; }
+
+  void copyFrom(const DynamicArray& other)
+  {
+    for (int i = 0; i < other._size; ++i)
+    {
+      new (data + i) T(other.data[i]);
+    }
+    _size = other._size;
+  }
+
 public:
-  DynamicArray(std::initializer_list< T > init)
+  // Without an allocator the array uses operator new; copies always do, so a copy
+  // never depends on the lifetime of the original's allocator.
+  DynamicArray(std::initializer_list< T > init, Allocator* allocator = nullptr)
+    : alloc(allocator ? allocator : Allocator::standard())
   {
-    _size = init.size();
+    _size = 0;
     _capacity = init.size();
-    data = new T[_capacity];
-    int i = 0;
+    data = _capacity ? allocate(_capacity) : nullptr;
     for (const auto& elem : init)
     {
-      data[i++] = elem;
+      new (data + _size++) T(elem);
     }
   }
 
-  DynamicArray()
+  explicit DynamicArray(Allocator* allocator) : alloc(allocator ? allocator : Allocator::standard())
   {
     _size = 0;
     _capacity = 4;
-    data = new T[_capacity];
+    data = allocate(_capacity);
+  }
+
+  DynamicArray() : DynamicArray(nullptr) {}
+
+  DynamicArray(const DynamicArray& other) : alloc(Allocator::standard())
+  {
+    _size = 0;
+    _capacity = other._capacity;
+    data = _capacity ? allocate(_capacity) : nullptr;
+    copyFrom(other);
   }
 
-  ~DynamicArray() { delete[] data; }
+  DynamicArray(DynamicArray&& other) noexcept
+  {
+    data = other.data;
+    _size = other._size;
+    _capacity = other._capacity;
+    alloc = other.alloc;
+    other.data = nullptr;
+    other._size = 0;
+    other._capacity = 0;
+  }
+
+  // Assignment keeps this array's allocator.
+  DynamicArray& operator=(const DynamicArray& other)
+  {
+    if (this == &other)
+      return *this;
+    clear();
+    if (_capacity < other._size)
+    {
+      destroy();
+      data = allocate(other._capacity);
+      _capacity = other._capacity;
+    }
+    copyFrom(other);
+    return *this;
+  }
+
+  DynamicArray& operator=(DynamicArray&& other)
+  {
+    if (this == &other)
+      return *this;
+    if (alloc != other.alloc)
+      return *this = static_cast< const DynamicArray& >(other);
+    std::swap(data, other.data);
+    std::swap(_size, other._size);
+    std::swap(_capacity, other._capacity);
+    return *this;
+  }
+
+  ~DynamicArray() { destroy(); }
+
+  // Grows at least geometrically, so reserving one more element per call stays amortized O(1).
+  void reserve(int newCapacity)
+  {
+    if (newCapacity > _capacity)
+      resize(newCapacity > grown() ? newCapacity : grown());
+  }
 
   void push_back(const T& value)
   {
     if (_size == _capacity)
     {
-      resize(_capacity * 2);
+      // value may live in this array, so it is copied before the old storage goes.
+      const int newCapacity = grown();
+      T* newData = allocate(newCapacity);
+      new (newData + _size) T(value);
+      adopt(newData, newCapacity);
+    }
+    else
+    {
+      new (data + _size) T(value);
     }
-    data[_size++] = value;
+    ++_size;
   }
 
+  void push_back(T&& value)
+  {
+    if (_size == _capacity)
+      resize(grown());
+    new (data + _size++) T(std::move(value));
+  }
+
+  void pop_back() { data[--_size].~T(); }
+
   T& operator[](int index) { return data[index]; }
 
   const T& operator[](int index) const { return data[index]; }
@@ -60,7 +165,16 @@ public:
 
   int capacity() const { return _capacity; }
 
-  void clear() { _size = 0; }
+  Allocator* getAllocator() const { return alloc; }
+
+  void clear()
+  {
+    for (int i = 0; i < _size; ++i)
+    {
+      data[i].~T();
+    }
+    _size = 0;
+  }
 
   T* begin() { return data; }
 
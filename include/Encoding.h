@@ -0,0 +1,72 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+#include <string>
+
+namespace Encoding
+{
+enum class Charset
+{
+  Auto,
+  UTF8,
+  UTF16LE,
+  UTF16BE,
+  CP1252,
+  CP1251,
+  CP949
+};
+
+bool fromName(const std::string& name, Charset& charset);
+
+// Detects a BOM, or UTF-16 from the zero-byte pattern of the sample; defaults to UTF-8.
+Charset sniff(const char* p, size_t n, size_t& bomLength);
+
+// Appends the UTF-8 form of the complete characters in [p, p + n) to out and returns
+// how many input bytes were used; a trailing partial character is left unless last is set.
+size_t decode(Charset charset, const char* p, size_t n, bool last, std::string& out);
+
+std::string toUtf8(const std::string& bytes, Charset charset = Charset::Auto);
+
+// Transcodes the source stream to UTF-8 chunk by chunk, so the raw input is never held whole.
+class DecodingBuffer : public std::streambuf
+{
+private:
+  std::istream& source;
+  Charset charset;
+  bool sniffed;
+  std::string raw;
+  size_t pending = 0;
+  std::string decoded;
+
+protected:
+  int_type underflow() override;
+
+public:
+  static const size_t chunkSize = 1 << 16;
+
+  DecodingBuffer(std::istream& in, Charset c = Charset::Auto);
+  Charset getCharset() const { return charset; }
+};
+
+class DecodingStream : public std::istream
+{
+private:
+  DecodingBuffer buffer;
+
+public:
+  explicit DecodingStream(std::istream& in, Charset c = Charset::Auto) : std::istream(nullptr), buffer(in, c)
+  {
+    rdbuf(&buffer);
+  }
+
+  Charset getCharset() const { return buffer.getCharset(); }
+};
+
+// Decodes the whole stream into one UTF-8 string, reading it a chunk at a time.
+std::string readUtf8(std::istream& in, Charset charset = Charset::Auto);
+}
+
+#endif
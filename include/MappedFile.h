@@ -0,0 +1,27 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only view of a whole file. On POSIX the file is memory-mapped, so only the pages
+// a caller touches are read from disk; elsewhere it is read into memory.
+class MappedFile
+{
+private:
+  const char* view = nullptr;
+  size_t length = 0;
+  bool mapped = false;
+  std::string fallback;
+
+public:
+  explicit MappedFile(const std::string& path);
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+  const char* data() const { return view; }
+  size_t size() const { return length; }
+};
+
+#endif
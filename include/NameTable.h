@@ -0,0 +1,79 @@
+#ifndef NAME_TABLE_H
+#define NAME_TABLE_H
+
+#include "DynamicArray.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Interns short names (styles, actors) to small integer ids; lookups by byte range do not allocate.
+class NameTable
+{
+private:
+  DynamicArray< std::string > names;
+  std::vector< int > slots;
+
+  size_t slotOf(const char* p, size_t n) const
+  {
+    const size_t mask = slots.size() - 1;
+    size_t i = hash(p, n) & mask;
+    while (slots[i] != -1)
+    {
+      const std::string& s = names[slots[i]];
+      if (s.size() == n && memcmp(s.data(), p, n) == 0)
+        break;
+      i = (i + 1) & mask;
+    }
+    return i;
+  }
+
+  void grow()
+  {
+    slots.assign(slots.size() * 2, -1);
+    for (int id = 0; id < names.size(); ++id)
+    {
+      slots[slotOf(names[id].data(), names[id].size())] = id;
+    }
+  }
+
+public:
+  NameTable() : slots(16, -1) {}
+
+  static uint32_t hash(const char* p, size_t n)
+  {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; ++i)
+    {
+      h ^= (unsigned char)p[i];
+      h *= 16777619u;
+    }
+    return h;
+  }
+
+  int find(const char* p, size_t n) const { return slots[slotOf(p, n)]; }
+  int find(const std::string& s) const { return find(s.data(), s.size()); }
+
+  int intern(const char* p, size_t n)
+  {
+    const size_t slot = slotOf(p, n);
+    if (slots[slot] != -1)
+      return slots[slot];
+    const int id = names.size();
+    names.push_back(std::string(p, n));
+    slots[slot] = id;
+    if ((size_t)names.size() * 2 > slots.size())
+      grow();
+    return id;
+  }
+
+  int intern(const std::string& s) { return intern(s.data(), s.size()); }
+
+  const std::string& name(int id) const { return names[id]; }
+
+  int size() const { return names.size(); }
+};
+
+#endif
@@ -8,11 +8,17 @@
 
 class SAMI : public Subtitle
 {
+protected:
+  size_t completeLength(const std::string &buffer) const override;
+  size_t estimateCues(const std::string &buffer) const override;
+
 public:
-  Structures::Time timeParse(const string &s) override;
-  string dialogueParse(const string &s) override;
-  void fileParse(istream &f) override;
-  DynamicArray< Structures::Node > getCollisions() override;
+  Structures::Time timeParse(const std::string &s) override;
+  std::string dialogueParse(const std::string &s) override;
+  void bufferParse(const std::string &buffer) override;
+  DynamicArray< Structures::Node > getCollisions() const override;
+  bool collides(const Structures::Node &first, const Structures::Node &second) const override;
+  DynamicArray< Structures::Node > getCollisionsParallel(unsigned threads) const override;
   void setFormat() override;
   void deleteFormat() override;
 };
@@ -8,13 +8,20 @@
 
 class SRT : public Subtitle
 {
+protected:
+  size_t completeLength(const std::string& buffer) const override;
+  size_t estimateCues(const std::string& buffer) const override;
+  size_t rangeHeader(const char* data, size_t size) const override;
+  bool cueBoundary(const char* data, size_t size, size_t& pos, Structures::Ticks& start) override;
+
 public:
-  Structures::Time timeParse(const string& s) override;
-  string dialogueParse(const string& s) override;
-  void fileParse(istream& f) override;
+  Structures::Time timeParse(const std::string& s) override;
+  std::string dialogueParse(const std::string& s) override;
+  void bufferParse(const std::string& buffer) override;
   void deleteFormat() override;
   void setFormat() override;
-  DynamicArray< Structures::Node > getCollisions() override;
+  DynamicArray< Structures::Node > getCollisions() const override;
+  bool collides(const Structures::Node& first, const Structures::Node& second) const override;
 };
 
 #endif
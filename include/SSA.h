@@ -8,11 +8,27 @@
 
 class SSA : public Subtitle
 {
+private:
+  bool inStyles = false;
+  bool inScriptInfo = false;
+
+  void styleParse(const std::string &s);
+  void namesParse(const std::string &s, Structures::Node &node);
+  static size_t textField(const char *line, size_t length);
+
+protected:
+  size_t completeLength(const std::string &buffer) const override;
+  size_t estimateCues(const std::string &buffer) const override;
+  size_t headerLength(const std::string &buffer) const override;
+  size_t rangeHeader(const char *data, size_t size) const override;
+  bool cueBoundary(const char *data, size_t size, size_t &pos, Structures::Ticks &start) override;
+
 public:
-  Structures::Time timeParse(const string &s) override;
-  string dialogueParse(const string &s) override;
-  void fileParse(istream &f) override;
-  DynamicArray< Structures::Node > getCollisions() override;
+  Structures::Time timeParse(const std::string &s) override;
+  std::string dialogueParse(const std::string &s) override;
+  void bufferParse(const std::string &buffer) override;
+  DynamicArray< Structures::Node > getCollisions() const override;
+  bool collides(const Structures::Node &first, const Structures::Node &second) const override;
   void setFormat() override;
   void deleteFormat() override;
 };
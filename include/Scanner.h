@@ -0,0 +1,54 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include "DynamicArray.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Scanner
+{
+// Bit i is set when p[i] == c, for the 64 bytes starting at p.
+uint64_t mask(const char* p, char c);
+
+size_t find(const char* data, size_t size, char c);
+size_t find(const char* data, size_t size, const char* needle, size_t length);
+size_t count(const char* data, size_t size, char c);
+// Non-overlapping occurrences of needle.
+size_t count(const char* data, size_t size, const char* needle, size_t length);
+void findAll(const char* data, size_t size, char c, DynamicArray< size_t >& out);
+
+const char* implementation();
+
+inline size_t find(const std::string& s, const char* needle, size_t length, size_t from = 0)
+{
+  if (from > s.size())
+    return std::string::npos;
+  const size_t pos = find(s.data() + from, s.size() - from, needle, length);
+  return pos == s.size() - from ? std::string::npos : from + pos;
+}
+
+// Splits a buffer into lines with the same results as repeated std::getline.
+class LineCursor
+{
+private:
+  const char* data;
+  size_t size;
+  size_t pos = 0;
+  size_t block = 0;
+  uint64_t bits = 0;
+  bool loaded = false;
+
+  size_t nextNewline();
+
+public:
+  LineCursor(const char* d, size_t n) : data(d), size(n) {}
+  explicit LineCursor(const std::string& s) : data(s.data()), size(s.size()) {}
+
+  bool next(std::string& line);
+  bool next(const char*& line, size_t& length);
+};
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of workers, each owning a deque of tasks. A worker runs its own newest task
+// first and, when it runs dry, steals the oldest task of another worker. Tasks submitted
+// from inside a task land on the submitting worker's deque.
+class WorkStealingScheduler
+{
+public:
+  struct WorkerStats
+  {
+    size_t tasks = 0;
+    size_t steals = 0;
+    double busySeconds = 0;
+  };
+
+private:
+  struct Worker
+  {
+    std::mutex lock;
+    std::deque< std::function< void() > > tasks;
+    WorkerStats stats;
+  };
+
+  std::vector< std::unique_ptr< Worker > > workers;
+  std::vector< std::thread > threads;
+  bool stealing;
+
+  std::atomic< size_t > queued;
+  std::atomic< size_t > pending;
+  std::atomic< unsigned > nextWorker;
+  bool stopping = false;
+  std::mutex sleepLock;
+  std::condition_variable wake;
+  std::condition_variable idle;
+
+  bool popLocal(unsigned self, std::function< void() >& task);
+  bool steal(unsigned self, std::function< void() >& task);
+  void run(unsigned self);
+
+public:
+  // Zero threads means one per hardware thread. Without stealing every worker only runs
+  // what was queued on it, which is static round-robin partitioning.
+  explicit WorkStealingScheduler(unsigned threadCount = 0, bool steal = true);
+  ~WorkStealingScheduler();
+
+  WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+  WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+  void submit(std::function< void() > task);
+
+  // Blocks until every submitted task, including the ones they spawned, has finished.
+  void wait();
+
+  unsigned size() const { return (unsigned)workers.size(); }
+
+  // Only meaningful between wait() and the next submit().
+  std::vector< WorkerStats > getStats() const;
+  void resetStats();
+};
+
+#endif
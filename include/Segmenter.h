@@ -0,0 +1,58 @@
+#ifndef SEGMENTER_H
+#define SEGMENTER_H
+
+#include "DynamicArray.h"
+#include "Structures.h"
+#include "WriteBehavior.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Splits cues into consecutive fixed-duration segments, as HLS subtitle renditions need,
+// in one pass over cues given in start order. A cue is written into every segment it
+// overlaps, and each segment is handed to the sink as soon as no later cue can reach it.
+// Segments without cues are still emitted, so segment n always starts at n * duration.
+class Segmenter
+{
+public:
+  // Receives the segment's number, its start time and the serialized document.
+  typedef std::function< void(size_t index, Structures::Ticks start, const std::string& document) > Sink;
+
+private:
+  const WriteBehavior& writer;
+  Structures::Ticks duration;
+  Sink sink;
+  Structures::StyleSheet styles;
+
+  std::vector< Structures::Node > active;
+  DynamicArray< Structures::Node > segment;
+  size_t index = 0;
+  Structures::Ticks lastStart = 0;
+
+  Structures::Ticks segmentStart() const { return (Structures::Ticks)index * duration; }
+  void close();
+
+public:
+  // Throws std::invalid_argument unless duration is positive.
+  Segmenter(const WriteBehavior& writer, Structures::Ticks duration, Sink sink,
+            const Structures::StyleSheet& styles = Structures::StyleSheet());
+
+  // Throws std::invalid_argument for a cue that starts before the previous one or before zero.
+  void push(const Structures::Node& node);
+  void push(const DynamicArray< Structures::Node >& nodes);
+
+  // Closes every segment still open; returns how many segments were emitted in total.
+  size_t finish();
+};
+
+namespace HLS
+{
+// Writes <prefix>NNNNN<extension> per segment as it closes, then <prefix>.m3u8 listing them.
+// nodes must be in start order (Subtitle::normalize); returns the number of segments.
+size_t writeSegments(const DynamicArray< Structures::Node >& nodes, const WriteBehavior& writer,
+                     Structures::Ticks duration, const std::string& prefix, const std::string& extension,
+                     const Structures::StyleSheet& styles = Structures::StyleSheet());
+}
+
+#endif
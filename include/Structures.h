@@ -1,40 +1,88 @@
 #ifndef STRUCTURES_H
 #define STRUCTURES_H
+#include "DynamicArray.h"
+#include "NameTable.h"
+#include "Text.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
 #include <string>
-using namespace std;
 
 namespace Structures
 {
+// Milliseconds; 64-bit so 24/7 streams do not wrap after ~596 hours.
+typedef int64_t Ticks;
+
 struct Time
 {
+  Ticks start = 0;
+  Ticks end = 0;
   int layer = 0;
-  int start = 0;
-  int end = 0;
 
   bool isEmpty() const { return start == 0 && end == 0; }
 
   Time() = default;
-  Time(int l, int s, int e) : layer(l), start(s), end(e) {}
+  Time(int l, Ticks s, Ticks e) : start(s), end(e), layer(l) {}
 
-  static int timeConverter(const string& s)
+  // Parses "H:MM:SS.f" to "HHH:MM:SS,fff" (any hour width, 1-3 fraction digits, '.' or ',').
+  static bool clockParse(const char* p, size_t n, Ticks& milliseconds);
+  static Time fromClocks(const char* begin, size_t beginLength, const char* end, size_t endLength, int layer = 0);
+  // "begin --> end" with the arrow at line[arrow]: each clock runs to the nearest blank or
+  // line edge, so hour fields wider than two digits are read whole.
+  static Time fromArrow(const char* line, size_t length, size_t arrow);
+
+  static Ticks timeConverter(const std::string& s)
   {
-    const int hours = stoi(s.substr(0, 2));
-    const int minutes = stoi(s.substr(3, 2));
-    const int seconds = stoi(s.substr(6, 2));
-    const int centiseconds = stoi(s.substr(9, 2));
-    const int milliseconds = centiseconds * 10;
-    const int totalMilliseconds = hours * 3600000 + minutes * 60000 + seconds * 1000 + milliseconds;
-    return totalMilliseconds;
+    Ticks milliseconds = 0;
+    if (!clockParse(s.data(), s.size(), milliseconds))
+      throw std::invalid_argument("Invalid timestamp: " + s);
+    return milliseconds;
   }
 };
 
 struct Node
 {
   Time time;
-  string dialogue = "";
+  Text dialogue;
+  int style = 0;
+  int actor = 0;
+  int layout = 0;
 
   Node() = default;
-  Node(const Time& t, const string& d) : time(t), dialogue(d) {}
+  Node(const Time& t, const Text& d) : time(t), dialogue(d) {}
+};
+
+// Style and actor names referenced by Node::style and Node::actor; id 0 is "Default" and "".
+// Node::layout refers to the raw "MarginL,MarginR,MarginV,Effect" fields of an SSA event,
+// id 0 being "0,0,0,".
+struct StyleSheet
+{
+  NameTable styles;
+  NameTable actors;
+  NameTable layouts;
+  std::string format;
+  DynamicArray< std::string > definitions;
+  // [Script Info] lines of a parsed script, written back in place of the default header.
+  DynamicArray< std::string > scriptInfo;
+
+  StyleSheet()
+  {
+    styles.intern("Default");
+    actors.intern("");
+    layouts.intern("0,0,0,");
+    definitions.push_back("");
+  }
+
+  bool isParsed() const { return !format.empty(); }
+
+  int addStyle(const char* p, size_t n)
+  {
+    const int id = styles.intern(p, n);
+    while (definitions.size() < styles.size())
+      definitions.push_back("");
+    return id;
+  }
 };
 };
 
@@ -1,51 +1,228 @@
 #ifndef SUBTITLE_H
 #define SUBTITLE_H
 
+#include "Allocator.h"
 #include "DynamicArray.h"
 #include "Structures.h"
+#include "Transform.h"
 #include "WriteBehavior.h"
 
+#include <algorithm>
 #include <fstream>
 #include <memory>
+#include <sstream>
 #include <string>
-using namespace std;
 
+// Instances share no mutable state: separate Subtitles may be parsed and written on separate
+// threads, and const members of one Subtitle may be called concurrently.
 class Subtitle
 {
 protected:
-  DynamicArray< Structures::Node > contents;
+  // Cue and dialogue storage for the whole document, freed in one go once the Subtitle and
+  // every Text taken from it are gone.
+  std::shared_ptr< MonotonicArena > arena = std::make_shared< MonotonicArena >();
+  DynamicArray< Structures::Node > contents{ arena.get() };
 
-  unique_ptr< WriteBehavior > write_behavior;
+  Structures::StyleSheet styles;
 
-  static void deltaStart(Structures::Node& n, const int det) { n.time.start += det; }
-  static void deltaEnd(Structures::Node& n, const int det) { n.time.end += det; }
-  static void deltaSE(Structures::Node& n, const int det)
+  std::unique_ptr< Structures::TextPool > pool;
+
+  Structures::Text makeText(const char* p, size_t n)
+  {
+    return pool ? pool->intern(p, n) : Structures::Text(p, n, arena);
+  }
+  Structures::Text makeText(const std::string& s) { return makeText(s.data(), s.size()); }
+
+  std::unique_ptr< WriteBehavior > write_behavior;
+
+  bool lazyFormat = false;
+  TextTransform transform;
+
+  std::string pending;
+
+  virtual size_t completeLength(const std::string& buffer) const = 0;
+
+  // Leading part of a document that must stay in the first chunk when it is split.
+  virtual size_t headerLength(const std::string& /*buffer*/) const { return 0; }
+
+  // Cue count guessed from a scan for the format's cue marker; parsers reserve this many nodes.
+  virtual size_t estimateCues(const std::string& /*buffer*/) const { return 0; }
+
+  // Reserves the node array, the intern table and, in the arena, room for every payload
+  // (which together cannot exceed the buffer), and returns the estimate, which also sizes
+  // the parsers' scratch text buffers.
+  size_t presize(const std::string& buffer)
+  {
+    const size_t cues = estimateCues(buffer);
+    if (cues == 0)
+      return 0;
+    contents.reserve(contents.size() + (int)cues);
+    if (pool)
+      pool->reserve(pool->size() + (int)cues);
+    arena->reserve(buffer.size());
+    return cues;
+  }
+
+  // Range extraction. A format that can seek returns how much of the document's start must be
+  // parsed before any window of cues (npos when it cannot seek), and finds the first cue at or
+  // after pos: pos is moved to where its text begins and start is its start time.
+  virtual size_t rangeHeader(const char* /*data*/, size_t /*size*/) const { return std::string::npos; }
+  virtual bool cueBoundary(const char* /*data*/, size_t /*size*/, size_t& /*pos*/, Structures::Ticks& /*start*/)
+  {
+    return false;
+  }
+
+  // Offset of the first cue in [from, size) starting at or after target, or size.
+  size_t firstCueFrom(const char* data, size_t size, size_t from, Structures::Ticks target);
+
+  static size_t averageText(const std::string& buffer, size_t cues)
+  {
+    return cues ? std::min< size_t >(buffer.size() / cues, 4096) : 0;
+  }
+
+  // Offset just past the last empty line of buffer, "\n\n" or "\n\r\n", or 0 when it has none.
+  static size_t pastLastBlankLine(const std::string& buffer)
+  {
+    for (size_t pos = buffer.rfind('\n'); pos != std::string::npos && pos > 0; pos = buffer.rfind('\n', pos - 1))
+    {
+      if (buffer[pos - 1] == '\n' || (buffer[pos - 1] == '\r' && pos > 1 && buffer[pos - 2] == '\n'))
+        return pos + 1;
+    }
+    return 0;
+  }
+
+  // Offset just past the first empty line of buffer, or 0 when it has none.
+  static size_t pastFirstBlankLine(const std::string& buffer)
+  {
+    for (size_t pos = buffer.find('\n'); pos != std::string::npos; pos = buffer.find('\n', pos + 1))
+    {
+      const size_t next = pos + 1 < buffer.size() && buffer[pos + 1] == '\r' ? pos + 2 : pos + 1;
+      if (next < buffer.size() && buffer[next] == '\n')
+        return next + 1;
+    }
+    return 0;
+  }
+
+  static std::string readAll(std::istream& f)
+  {
+    std::ostringstream buffer;
+    buffer << f.rdbuf();
+    return buffer.str();
+  }
+
+  static void deltaStart(Structures::Node& n, const Structures::Ticks det) { n.time.start += det; }
+  static void deltaEnd(Structures::Node& n, const Structures::Ticks det) { n.time.end += det; }
+  static void deltaSE(Structures::Node& n, const Structures::Ticks det)
   {
     n.time.start += det;
     n.time.end += det;
   }
 
 public:
+  Subtitle() = default;
+  Subtitle(const Subtitle&) = delete;
+  Subtitle& operator=(const Subtitle&) = delete;
+
   DynamicArray< Structures::Node >& getContents() { return contents; }
   const DynamicArray< Structures::Node >& getContents() const { return contents; }
 
+  Structures::StyleSheet& getStyles() { return styles; }
+  const Structures::StyleSheet& getStyles() const { return styles; }
+
+  const MonotonicArena& getArena() const { return *arena; }
+
+  // Identical dialogue lines parsed from now on share one buffer.
+  void setInterning(bool enabled)
+  {
+    if (enabled && !pool)
+      pool.reset(new Structures::TextPool(arena));
+    else if (!enabled)
+      pool.reset();
+  }
+  bool isInterning() const { return pool != nullptr; }
+
+  // setFormat/deleteFormat only record the operation; it is applied while writing.
+  void setLazyFormat(bool enabled)
+  {
+    if (!enabled)
+      applyFormat();
+    lazyFormat = enabled;
+  }
+  bool isLazyFormat() const { return lazyFormat; }
+  const TextTransform& getTransform() const { return transform; }
+  void applyFormat();
+
   void setWriteBehavior(std::unique_ptr< WriteBehavior > behavior) { write_behavior = std::move(behavior); }
 
-  virtual void write(ofstream& out) const
+  virtual void write(std::ofstream& out) const { write(out, Pipeline(transform)); }
+
+  // Seed the pipeline with getTransform() to keep pending lazy format changes.
+  void write(std::ostream& out, const Pipeline& pipeline) const
   {
     if (write_behavior)
-      write_behavior->write(out, contents);
+      write_behavior->write(out, contents, styles, pipeline);
+  }
+
+  // Same output as write(), with cue ranges serialized on the scheduler's workers.
+  void writeParallel(std::ostream& out, WorkStealingScheduler& scheduler) const
+  {
+    if (write_behavior)
+      write_behavior->writeParallel(out, contents, styles, Pipeline(transform), scheduler);
+  }
+
+  // In-memory conversion: the whole output in one exactly sized allocation.
+  std::string writeToString() const { return writeToString(Pipeline(transform)); }
+  std::string writeToString(const Pipeline& pipeline) const
+  {
+    return write_behavior ? write_behavior->writeToString(contents, styles, pipeline) : std::string();
   }
 
   virtual ~Subtitle() = default;
 
-  virtual Structures::Time timeParse(const string& s) = 0;
-  virtual string dialogueParse(const string& s) = 0;
-  virtual DynamicArray< Structures::Node > getCollisions() = 0;
+  virtual Structures::Time timeParse(const std::string& s) = 0;
+  virtual std::string dialogueParse(const std::string& s) = 0;
+  virtual DynamicArray< Structures::Node > getCollisions() const = 0;
+  virtual bool collides(const Structures::Node& first, const Structures::Node& second) const = 0;
+  virtual DynamicArray< Structures::Node > getCollisionsParallel(unsigned threads) const;
+
+  // Cuts a document into pieces of roughly chunkSize bytes at cue boundaries; parsing the
+  // pieces separately and merging them gives the same cues as parsing the whole.
+  DynamicArray< std::string > split(const std::string& text, size_t chunkSize) const;
+
+  // Adds the cues overlapping [from, to) of a document sorted by start time. SRT and SSA
+  // binary-search the buffer for the cues starting in [from - longestCue, to) and parse only
+  // those; other formats parse everything. Returns false when the whole document was parsed.
+  bool rangeParse(const char* data, size_t size, Structures::Ticks from, Structures::Ticks to,
+                  Structures::Ticks longestCue = 60000);
+
+  // Merges the cues of sources and this Subtitle's own cues by start time; ties keep this
+  // Subtitle's cues first and then the order of sources. this may itself be listed in sources.
+  void merge(const DynamicArray< const Subtitle* >& sources);
+  void normalize();
   virtual void deleteFormat() = 0;
   virtual void setFormat() = 0;
 
-  virtual void fileParse(istream& f) = 0;
+  // Parses a whole document already decoded to UTF-8, without copying it.
+  virtual void bufferParse(const std::string& buffer) = 0;
+  virtual void fileParse(std::istream& f) { bufferParse(readAll(f)); }
+
+  void appendParse(const std::string& chunk)
+  {
+    pending += chunk;
+    const size_t n = completeLength(pending);
+    if (n == 0)
+      return;
+    bufferParse(pending.substr(0, n));
+    pending.erase(0, n);
+  }
+
+  void finishParse()
+  {
+    if (pending.empty())
+      return;
+    bufferParse(pending);
+    pending.clear();
+  }
 };
 
 #endif
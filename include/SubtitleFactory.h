@@ -5,39 +5,94 @@
 #include "SSA.h"
 #include "Subtitle.h"
 #include "TTML.h"
+#include "VTT.h"
 #include "WriteBehavior.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <string>
 
+// One row of the format registry: how a format is recognised and what reads and writes it.
+struct SubtitleFormat
+{
+  const char* extension;
+  // Trimmed first lines that identify the format when the extension is unknown.
+  const char* signatures[2];
+  std::unique_ptr< Subtitle > (*makeParser)();
+  std::unique_ptr< WriteBehavior > (*makeWriter)();
+
+  // Parser with this format's writer attached.
+  std::unique_ptr< Subtitle > create() const
+  {
+    std::unique_ptr< Subtitle > sub = makeParser();
+    sub->setWriteBehavior(makeWriter());
+    return sub;
+  }
+};
+
+// Adding a format means adding one row to formats(); lookups return the row, so callers
+// that handle many files of one format resolve it once and call create() per file.
 class SubtitleFactory
 {
+private:
+  template < typename P > static std::unique_ptr< Subtitle > parser() { return std::make_unique< P >(); }
+  template < typename W > static std::unique_ptr< WriteBehavior > writer() { return std::make_unique< W >(); }
+
 public:
-  static std::unique_ptr< Subtitle > create(const std::string& format)
+  static const SubtitleFormat* formats(size_t& count)
   {
-    if (format == ".srt")
-    {
-      auto srt = std::make_unique< SRT >();
-      srt->setWriteBehavior(std::make_unique< toSRT >());
-      return srt;
-    }
-    else if (format == ".smi")
-    {
-      auto sami = std::make_unique< SAMI >();
-      sami->setWriteBehavior(std::make_unique< toSAMI >());
-      return sami;
-    }
-    else if (format == ".ass")
+    static constexpr SubtitleFormat table[] = {
+      { ".srt", { "1", "0" }, &parser< SRT >, &writer< toSRT > },
+      { ".smi", { "<SAMI>", nullptr }, &parser< SAMI >, &writer< toSAMI > },
+      { ".ass", { "[Script Info]", nullptr }, &parser< SSA >, &writer< toSSA > },
+      { ".ttml", { nullptr, nullptr }, &parser< TTML >, &writer< toTTML > },
+      { ".vtt", { "WEBVTT", nullptr }, &parser< VTT >, &writer< toVTT > },
+    };
+    count = sizeof(table) / sizeof(table[0]);
+    return table;
+  }
+
+  static const SubtitleFormat* find(const std::string& extension)
+  {
+    size_t count;
+    const SubtitleFormat* table = formats(count);
+    for (size_t i = 0; i < count; ++i)
     {
-      auto ssa = std::make_unique< SSA >();
-      ssa->setWriteBehavior(std::make_unique< toSSA >());
-      return ssa;
+      if (extension == table[i].extension)
+        return &table[i];
     }
-    else if (format == ".ttml")
+    return nullptr;
+  }
+
+  // Format whose signature matches the first line of a document, ignoring surrounding blanks.
+  // The line is compared in place, so a whole decoded document can be passed.
+  static const SubtitleFormat* sniff(const char* data, size_t size)
+  {
+    const char* end = std::find(data, data + size, '\n');
+    const char* blanks = " \t\r\n";
+    while (data < end && std::memchr(blanks, *data, 4))
+      ++data;
+    while (end > data && std::memchr(blanks, end[-1], 4))
+      --end;
+    const size_t length = end - data;
+    size_t count;
+    const SubtitleFormat* table = formats(count);
+    for (size_t i = 0; i < count; ++i)
     {
-      auto ttml = std::make_unique< TTML >();
-      ttml->setWriteBehavior(std::make_unique< toTTML >());
-      return ttml;
+      for (const char* signature : table[i].signatures)
+      {
+        if (signature && std::strlen(signature) == length && std::memcmp(signature, data, length) == 0)
+          return &table[i];
+      }
     }
     return nullptr;
   }
+  static const SubtitleFormat* sniff(const std::string& text) { return sniff(text.data(), text.size()); }
+
+  static std::unique_ptr< Subtitle > create(const std::string& format)
+  {
+    const SubtitleFormat* entry = find(format);
+    return entry ? entry->create() : nullptr;
+  }
 };
@@ -8,13 +8,18 @@
 
 class TTML : public Subtitle
 {
+protected:
+  size_t completeLength(const std::string& buffer) const override;
+  size_t estimateCues(const std::string& buffer) const override;
+
 public:
-  Structures::Time timeParse(const string& s) override;
-  string dialogueParse(const string& s) override;
-  void fileParse(istream& f) override;
+  Structures::Time timeParse(const std::string& s) override;
+  std::string dialogueParse(const std::string& s) override;
+  void bufferParse(const std::string& buffer) override;
   void deleteFormat() override;
   void setFormat() override;
-  DynamicArray< Structures::Node > getCollisions() override;
+  DynamicArray< Structures::Node > getCollisions() const override;
+  bool collides(const Structures::Node& first, const Structures::Node& second) const override;
 };
 
 #endif
@@ -0,0 +1,143 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include "Allocator.h"
+#include "DynamicArray.h"
+#include "NameTable.h"
+
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Structures
+{
+// Immutable dialogue payload: a byte range that shares ownership of the storage holding it.
+// Copies share one buffer, so interned lines are stored once and equal interned lines compare
+// by pointer. Text cut from a document points into that document's arena and keeps the arena
+// alive, so cues copied out of a Subtitle stay valid after it is destroyed.
+class Text
+{
+private:
+  std::shared_ptr< const char > value;
+  size_t length = 0;
+
+public:
+  Text() = default;
+  Text(const std::string& s) : Text(std::string(s)) {}
+  Text(std::string&& s)
+  {
+    if (s.empty())
+      return;
+    auto owner = std::make_shared< std::string >(std::move(s));
+    length = owner->size();
+    value = std::shared_ptr< const char >(owner, owner->data());
+  }
+  Text(const char* s) : Text(std::string(s)) {}
+  // Copies [p, p + n) into arena.
+  Text(const char* p, size_t n, const std::shared_ptr< MonotonicArena >& arena)
+  {
+    if (n == 0)
+      return;
+    char* copy = static_cast< char* >(arena->allocate(n, 1));
+    memcpy(copy, p, n);
+    value = std::shared_ptr< const char >(arena, copy);
+    length = n;
+  }
+
+  std::string str() const { return std::string(data(), length); }
+  operator std::string() const { return str(); }
+
+  bool empty() const { return length == 0; }
+  size_t size() const { return length; }
+  const char* data() const { return value ? value.get() : ""; }
+  bool shares(const Text& other) const { return value == other.value && length == other.length; }
+  bool equals(const char* p, size_t n) const { return n == length && memcmp(data(), p, n) == 0; }
+};
+
+inline bool operator==(const Text& a, const Text& b) { return a.shares(b) || a.equals(b.data(), b.size()); }
+inline bool operator==(const Text& a, const std::string& b) { return a.equals(b.data(), b.size()); }
+inline bool operator==(const std::string& a, const Text& b) { return b == a; }
+inline bool operator==(const Text& a, const char* b) { return a.equals(b, strlen(b)); }
+inline bool operator==(const char* a, const Text& b) { return b == a; }
+inline bool operator!=(const Text& a, const Text& b) { return !(a == b); }
+inline bool operator!=(const Text& a, const std::string& b) { return !(a == b); }
+inline bool operator!=(const Text& a, const char* b) { return !(a == b); }
+
+inline std::string operator+(const char* a, const Text& b) { return a + b.str(); }
+inline std::string operator+(const Text& a, const char* b) { return a.str() + b; }
+inline std::string operator+(const std::string& a, const Text& b) { return a + b.str(); }
+inline std::string operator+(const Text& a, const std::string& b) { return a.str() + b; }
+
+inline std::ostream& operator<<(std::ostream& out, const Text& t) { return out.write(t.data(), t.size()); }
+
+// Hash-consing pool: identical payloads map to the same shared buffer.
+class TextPool
+{
+private:
+  DynamicArray< Text > texts;
+  std::vector< int > slots;
+  // Where new payloads are copied; without one each payload has its own buffer.
+  std::shared_ptr< MonotonicArena > storage;
+
+  size_t slotOf(const char* p, size_t n) const
+  {
+    const size_t mask = slots.size() - 1;
+    size_t i = NameTable::hash(p, n) & mask;
+    while (slots[i] != -1)
+    {
+      if (texts[slots[i]].equals(p, n))
+        break;
+      i = (i + 1) & mask;
+    }
+    return i;
+  }
+
+  void grow()
+  {
+    slots.assign(slots.size() * 2, -1);
+    for (int id = 0; id < texts.size(); ++id)
+    {
+      slots[slotOf(texts[id].data(), texts[id].size())] = id;
+    }
+  }
+
+public:
+  explicit TextPool(std::shared_ptr< MonotonicArena > arena = nullptr) : slots(64, -1), storage(std::move(arena)) {}
+
+  Text intern(const char* p, size_t n)
+  {
+    if (n == 0)
+      return Text();
+    const size_t slot = slotOf(p, n);
+    if (slots[slot] != -1)
+      return texts[slots[slot]];
+    slots[slot] = texts.size();
+    texts.push_back(storage ? Text(p, n, storage) : Text(std::string(p, n)));
+    if ((size_t)texts.size() * 2 > slots.size())
+      grow();
+    return texts[texts.size() - 1];
+  }
+
+  Text intern(const std::string& s) { return intern(s.data(), s.size()); }
+
+  // Sizes the table for n distinct payloads so interning them never rehashes.
+  void reserve(int n)
+  {
+    texts.reserve(n);
+    size_t wanted = slots.size();
+    while ((size_t)n * 2 > wanted)
+      wanted *= 2;
+    if (wanted != slots.size())
+    {
+      slots.assign(wanted / 2, -1);
+      grow();
+    }
+  }
+
+  int size() const { return texts.size(); }
+};
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef TRANSCODE_H
+#define TRANSCODE_H
+
+#include <string>
+
+struct SubtitleFormat;
+
+// Direct conversions that scan the source text and append the target text, copying dialogue
+// spans as they are and re-encoding only timestamps; no Node is built. Each produces what
+// parse, normalize and write would, and returns false, leaving output unspecified, for input
+// it does not take: cues out of order, or lines the generic parser would turn into odd cues.
+namespace Transcode
+{
+typedef bool (*Path)(const std::string& input, std::string& output);
+
+bool srtToTtml(const std::string& input, std::string& output);
+bool ssaToSrt(const std::string& input, std::string& output);
+bool srtToVtt(const std::string& input, std::string& output);
+bool vttToSrt(const std::string& input, std::string& output);
+
+// Fast path between two registry formats, or nullptr when the pair has none.
+Path find(const SubtitleFormat* from, const SubtitleFormat* to);
+}
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "Structures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Format changes recorded instead of applied; writers emit the decorated text in one pass.
+class TextTransform
+{
+  public:
+	enum StripRule
+	{
+		None,
+		BracesAndTags, // {...} and <...> within one line, as deleteFormat of SRT, SAMI and SSA
+		Tags		   // <...> with at least one character inside, as TTML::deleteFormat
+	};
+
+  private:
+	// A strip step, or a wrap when rule is None.
+	struct Step
+	{
+		StripRule rule;
+		const char *open;
+		const char *close;
+	};
+
+	// Rule of the last strip recorded.
+	StripRule rule = None;
+	// Every step up to and including the last strip, in the order recorded. A lone strip is done
+	// on the fly; when wraps or other strips come before it, the steps are replayed over a copy
+	// of the text, so tags the eager passes would strip across the wraps go the same way.
+	std::vector< Step > head;
+	// (open, close) pairs recorded after the last strip; the first one sits innermost.
+	std::vector< std::pair< const char *, const char * > > wraps;
+
+	static size_t closing(const char *s, size_t n, size_t from, char c, bool singleLine)
+	{
+		for (size_t j = from; j < n; ++j)
+		{
+			if (s[j] == c)
+				return j;
+			if (singleLine && (s[j] == '\n' || s[j] == '\r'))
+				return std::string::npos;
+		}
+		return std::string::npos;
+	}
+
+	// Position after the tag starting at i, or i when no tag starts there.
+	static size_t tagEnd(StripRule r, const char *s, size_t n, size_t i)
+	{
+		if (r == BracesAndTags && (s[i] == '{' || s[i] == '<'))
+		{
+			const size_t j = closing(s, n, i + 1, s[i] == '{' ? '}' : '>', true);
+			return j == std::string::npos ? i : j + 1;
+		}
+		if (r == Tags && s[i] == '<')
+		{
+			const size_t j = closing(s, n, i + 1, '>', false);
+			return j == std::string::npos || j == i + 1 ? i : j + 1;
+		}
+		return i;
+	}
+
+	// Hands the parts of s left after stripping by r to sink(pointer, length).
+	template < typename Sink > static void stripped(StripRule r, const char *s, size_t n, Sink sink)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < n;)
+		{
+			const size_t end = tagEnd(r, s, n, i);
+			if (end == i)
+			{
+				++i;
+				continue;
+			}
+			sink(s + kept, i - kept);
+			kept = i = end;
+		}
+		sink(s + kept, n - kept);
+	}
+
+	// The text after every step of head, applied one at a time.
+	std::string replay(const Structures::Text &text) const
+	{
+		std::string current(text.data(), text.size());
+		for (const Step &step : head)
+		{
+			if (step.rule == None)
+			{
+				current.insert(0, step.open);
+				current += step.close;
+				continue;
+			}
+			std::string next;
+			next.reserve(current.size());
+			stripped(step.rule, current.data(), current.size(), [&next](const char *p, size_t n) { next.append(p, n); });
+			current.swap(next);
+		}
+		return current;
+	}
+
+	// Hands the text after head to sink(pointer, length), in one or more parts.
+	template < typename Sink > void body(const Structures::Text &text, Sink sink) const
+	{
+		if (head.empty())
+			sink(text.data(), text.size());
+		else if (head.size() == 1)
+			stripped(rule, text.data(), text.size(), sink);
+		else
+		{
+			const std::string replayed = replay(text);
+			sink(replayed.data(), replayed.size());
+		}
+	}
+
+  public:
+	void wrap(const char *openTag, const char *closeTag)
+	{
+		wraps.emplace_back(openTag, closeTag);
+	}
+
+	// The wraps recorded so far are stripped along with the text, as the eager passes do.
+	void strip(StripRule r)
+	{
+		for (const auto &w : wraps)
+			head.push_back({ None, w.first, w.second });
+		wraps.clear();
+		head.push_back({ r, nullptr, nullptr });
+		rule = r;
+	}
+
+	bool isIdentity() const { return head.empty() && wraps.empty(); }
+	bool strips() const { return !head.empty(); }
+
+	void emit(std::ostream &out, const Structures::Text &text) const
+	{
+		for (auto w = wraps.rbegin(); w != wraps.rend(); ++w)
+			out << w->first;
+		body(text, [&out](const char *p, size_t n) { out.write(p, n); });
+		for (const auto &w : wraps)
+			out << w.second;
+	}
+
+	// Bytes emit() writes for text.
+	size_t length(const Structures::Text &text) const
+	{
+		size_t bytes = 0;
+		for (const auto &w : wraps)
+			bytes += strlen(w.first) + strlen(w.second);
+		body(text, [&bytes](const char *, size_t part) { bytes += part; });
+		return bytes;
+	}
+
+	// True when nothing but tags is left of the line once stripped by the last rule; wraps are not counted.
+	bool strippedEmpty(const Structures::Text &text) const
+	{
+		const char *s = text.data();
+		const size_t n = text.size();
+		for (size_t i = 0; i < n;)
+		{
+			const size_t end = tagEnd(rule, s, n, i);
+			if (end == i)
+				return false;
+			i = end;
+		}
+		return true;
+	}
+
+	std::string apply(const Structures::Text &text) const
+	{
+		std::string result;
+		for (auto w = wraps.rbegin(); w != wraps.rend(); ++w)
+			result += w->first;
+		body(text, [&result](const char *p, size_t n) { result.append(p, n); });
+		for (const auto &w : wraps)
+			result += w.second;
+		return result;
+	}
+};
+
+// Per-cue operations chained once and run by the writers while they serialize, so a
+// strip/wrap/shift/filter job walks the cues a single time. Time operations compose into
+// one affine map; a time range is kept in output time, so it applies to the cue times
+// as they are when the filter is added.
+class Pipeline
+{
+  private:
+	TextTransform text;
+	double factor = 1.0;
+	double offset = 0.0;
+	Structures::Ticks from = std::numeric_limits< Structures::Ticks >::min();
+	Structures::Ticks to = std::numeric_limits< Structures::Ticks >::max();
+	bool ranged = false;
+	bool dropping = false;
+
+	Structures::Ticks map(Structures::Ticks t) const
+	{
+		if (factor == 1.0)
+			return t + (Structures::Ticks)std::llround(offset);
+		return (Structures::Ticks)std::llround(t * factor + offset);
+	}
+
+  public:
+	Pipeline() = default;
+	Pipeline(const TextTransform &transform) : text(transform) {}
+
+	Pipeline &strip(TextTransform::StripRule rule)
+	{
+		text.strip(rule);
+		return *this;
+	}
+
+	Pipeline &wrap(const char *openTag, const char *closeTag)
+	{
+		text.wrap(openTag, closeTag);
+		return *this;
+	}
+
+	Pipeline &shift(Structures::Ticks delta)
+	{
+		offset += delta;
+		if (ranged)
+		{
+			from += delta;
+			to += delta;
+		}
+		return *this;
+	}
+
+	Pipeline &scale(double f)
+	{
+		if (!(f > 0.0))
+			throw std::invalid_argument("Pipeline scale factor must be positive");
+		factor *= f;
+		offset *= f;
+		if (ranged)
+		{
+			from = (Structures::Ticks)std::llround(from * f);
+			to = (Structures::Ticks)std::llround(to * f);
+		}
+		return *this;
+	}
+
+	// Keeps cues overlapping [begin, end).
+	Pipeline &between(Structures::Ticks begin, Structures::Ticks end)
+	{
+		from = ranged ? std::max(from, begin) : begin;
+		to = ranged ? std::min(to, end) : end;
+		ranged = true;
+		return *this;
+	}
+
+	Pipeline &dropEmpty()
+	{
+		dropping = true;
+		return *this;
+	}
+
+	const TextTransform &getText() const { return text; }
+
+	// Output time of a cue, or false when the cue is filtered out.
+	bool accept(const Structures::Node &node, Structures::Time &out) const
+	{
+		out = node.time;
+		out.start = map(node.time.start);
+		out.end = map(node.time.end);
+		if (ranged && !(out.start < to && from < out.end))
+			return false;
+		return !(dropping && text.strippedEmpty(node.dialogue));
+	}
+
+	void emit(std::ostream &out, const Structures::Text &dialogue) const { text.emit(out, dialogue); }
+	size_t length(const Structures::Text &dialogue) const { return text.length(dialogue); }
+};
+
+#endif
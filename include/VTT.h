@@ -0,0 +1,51 @@
+#ifndef VTT_H
+#define VTT_H
+
+#include "DynamicArray.h"
+#include "Scanner.h"
+#include "Subtitle.h"
+
+#include <regex>
+
+class VTT : public Subtitle
+{
+protected:
+  size_t completeLength(const std::string& buffer) const override;
+  size_t headerLength(const std::string& buffer) const override;
+  size_t estimateCues(const std::string& buffer) const override;
+
+public:
+  // Walks the cues of a WebVTT buffer as byte ranges, copying only multi-line CRLF cues. The
+  // WEBVTT header block, NOTE, STYLE and REGION blocks and cue settings are skipped.
+  class CueCursor
+  {
+  private:
+    Scanner::LineCursor lines;
+    bool first = true;
+    std::string joined;
+
+    bool nextLine(const char*& line, size_t& length);
+    void skipBlock();
+
+  public:
+    explicit CueCursor(const std::string& buffer) : lines(buffer) {}
+
+    // text spans every line of the cue joined by '\n'; it points into the buffer unless the
+    // lines end in CRLF, and then stays valid until the next call. A cue whose timing line
+    // does not parse comes back with an empty time.
+    bool next(Structures::Time& time, const char*& text, size_t& length);
+  };
+
+  // "[HH:]MM:SS.mmm --> [HH:]MM:SS.mmm [settings]"
+  static Structures::Time timingParse(const char* line, size_t length);
+
+  Structures::Time timeParse(const std::string& s) override;
+  std::string dialogueParse(const std::string& s) override;
+  void bufferParse(const std::string& buffer) override;
+  void deleteFormat() override;
+  void setFormat() override;
+  DynamicArray< Structures::Node > getCollisions() const override;
+  bool collides(const Structures::Node& first, const Structures::Node& second) const override;
+};
+
+#endif
@@ -2,114 +2,549 @@
 #define WRITEBEHAVIOR_H
 
 #include "DynamicArray.h"
+#include "Scheduler.h"
 #include "Structures.h"
+#include "Transform.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <sstream>
+#include <streambuf>
 #include <string>
+#include <vector>
 
-class WriteBehavior
+// Stream buffer that only counts what is written to it.
+class CountingBuffer : public std::streambuf
 {
+  private:
+	size_t count = 0;
+
   protected:
-	std::string timeFormat(int totalMilliseconds, char format)
+	std::streamsize xsputn(const char *, std::streamsize n) override
 	{
-		int hours = totalMilliseconds / 3600000;
-		totalMilliseconds %= 3600000;
-		int minutes = totalMilliseconds / 60000;
-		totalMilliseconds %= 60000;
-		int seconds = totalMilliseconds / 1000;
-		int milliseconds = totalMilliseconds % 1000;
-		char buffer[16];
-		sprintf(buffer, "%02d:%02d:%02d%c%03d", hours, minutes, seconds, format, milliseconds);
-		return std::string(buffer);
+		count += n;
+		return n;
+	}
+	int_type overflow(int_type c) override
+	{
+		if (!traits_type::eq_int_type(c, traits_type::eof()))
+			++count;
+		return traits_type::not_eof(c);
 	}
 
   public:
-	virtual void write(std::ostream &out, const DynamicArray< Structures::Node > &v) = 0;
-	virtual ~WriteBehavior() = default;
+	size_t size() const { return count; }
 };
 
-class toSRT : public WriteBehavior
+// Stream buffer over caller-owned memory; writing past the end sets badbit instead of growing.
+class FixedBuffer : public std::streambuf
+{
+  public:
+	FixedBuffer(char *data, size_t size) { setp(data, data + size); }
+	size_t size() const { return pptr() - pbase(); }
+};
+
+// Writers are stateless; one instance may serve any number of threads.
+class WriteBehavior
 {
+  protected:
+	// The only virtual calls of a write: header and footer once, writeRange once per range of cues.
+	virtual void header(std::ostream &, const Structures::StyleSheet &) const {}
+	virtual void footer(std::ostream &) const {}
+
+	// Cues of v in [from, to) that the pipeline keeps, numbered after first.
+	virtual void writeRange(std::ostream &out, const DynamicArray< Structures::Node > &v, int from, int to,
+							size_t first, const Structures::StyleSheet &styles, const Pipeline &pipeline) const = 0;
+
+	// Bytes writeRange would produce for the same arguments, computed without formatting the cues.
+	virtual size_t measureRange(const DynamicArray< Structures::Node > &v, int from, int to, size_t first,
+								const Structures::StyleSheet &styles, const Pipeline &pipeline) const = 0;
+
+	// Formats whose cues carry their index need kept-cue counts of earlier ranges before writing in parallel.
+	virtual bool numbered() const { return false; }
+
   public:
-	void write(std::ostream &out, const DynamicArray< Structures::Node > &v) override
+	// Every cue goes through the pipeline once: filtered, retimed and its text transformed as it is written.
+	void write(std::ostream &out, const DynamicArray< Structures::Node > &v, const Structures::StyleSheet &styles,
+			   const Pipeline &pipeline) const
+	{
+		header(out, styles);
+		writeRange(out, v, 0, v.size(), 0, styles, pipeline);
+		footer(out);
+	}
+
+	void write(std::ostream &out, const DynamicArray< Structures::Node > &v) const
+	{
+		write(out, v, Structures::StyleSheet(), Pipeline());
+	}
+	void write(std::ostream &out, const DynamicArray< Structures::Node > &v, const Structures::StyleSheet &styles) const
+	{
+		write(out, v, styles, Pipeline());
+	}
+
+	// Pieces of write() for callers that serialize ranges of cues in their own tasks: the header,
+	// then each range into its own buffer, numbered after the cues kept() by the ranges before it
+	// when isNumbered(), then the footer.
+	void writeHeader(std::ostream &out, const Structures::StyleSheet &styles) const { header(out, styles); }
+	void writeFooter(std::ostream &out) const { footer(out); }
+	void writePart(std::ostream &out, const DynamicArray< Structures::Node > &v, int from, int to, size_t first,
+				   const Structures::StyleSheet &styles, const Pipeline &pipeline) const
+	{
+		writeRange(out, v, from, to, first, styles, pipeline);
+	}
+	bool isNumbered() const { return numbered(); }
+	size_t kept(const DynamicArray< Structures::Node > &v, int from, int to, const Pipeline &pipeline) const
+	{
+		size_t count = 0;
+		Structures::Time t;
+		for (int i = from; i < to; ++i)
+			count += pipeline.accept(v[i], t);
+		return count;
+	}
+
+	// Same bytes as write(). Contiguous ranges of chunkCues cues (0 picks four per worker) are serialized
+	// into their own buffers on the scheduler and copied to out in order; SRT numbering comes from a
+	// parallel count of the cues each earlier range keeps. Call it from outside the scheduler's tasks.
+	void writeParallel(std::ostream &out, const DynamicArray< Structures::Node > &v, const Structures::StyleSheet &styles,
+					   const Pipeline &pipeline, WorkStealingScheduler &scheduler, int chunkCues = 0) const
+	{
+		if (chunkCues <= 0)
+			chunkCues = std::max(1024, (int)(v.size() / (scheduler.size() * 4)) + 1);
+		const int chunks = (v.size() + chunkCues - 1) / chunkCues;
+		if (chunks <= 1)
+		{
+			write(out, v, styles, pipeline);
+			return;
+		}
+
+		std::vector< size_t > first(chunks, 0);
+		if (numbered())
+		{
+			for (int c = 0; c < chunks; ++c)
+			{
+				scheduler.submit(
+					[&, c]() { first[c] = kept(v, c * chunkCues, std::min(v.size(), (c + 1) * chunkCues), pipeline); });
+			}
+			scheduler.wait();
+			size_t kept = 0;
+			for (int c = 0; c < chunks; ++c)
+			{
+				const size_t count = first[c];
+				first[c] = kept;
+				kept += count;
+			}
+		}
+
+		std::vector< std::string > buffers(chunks);
+		for (int c = 0; c < chunks; ++c)
+		{
+			scheduler.submit([&, c]() {
+				std::ostringstream piece;
+				writeRange(piece, v, c * chunkCues, std::min(v.size(), (c + 1) * chunkCues), first[c], styles, pipeline);
+				buffers[c] = piece.str();
+			});
+		}
+		scheduler.wait();
+
+		header(out, styles);
+		for (const auto &buffer : buffers)
+			out.write(buffer.data(), buffer.size());
+		footer(out);
+	}
+
+	// Exact byte length of write()'s output. Header and footer are counted by writing them once;
+	// each cue's length is added up from its stamps, index and transformed text size.
+	size_t measure(const DynamicArray< Structures::Node > &v,
+				   const Structures::StyleSheet &styles = Structures::StyleSheet(),
+				   const Pipeline &pipeline = Pipeline()) const
 	{
-		for (size_t i = 0; i < v.size(); ++i)
+		CountingBuffer counter;
+		std::ostream out(&counter);
+		header(out, styles);
+		footer(out);
+		return counter.size() + measureRange(v, 0, v.size(), 0, styles, pipeline);
+	}
+
+	// Writes into buffer and returns the bytes used; size it with measure().
+	size_t writeTo(char *buffer, size_t capacity, const DynamicArray< Structures::Node > &v,
+				   const Structures::StyleSheet &styles = Structures::StyleSheet(),
+				   const Pipeline &pipeline = Pipeline()) const
+	{
+		FixedBuffer sink(buffer, capacity);
+		std::ostream out(&sink);
+		write(out, v, styles, pipeline);
+		return sink.size();
+	}
+
+	// Sized by measure(), then serialized once into a string allocated at the exact size.
+	std::string writeToString(const DynamicArray< Structures::Node > &v,
+							  const Structures::StyleSheet &styles = Structures::StyleSheet(),
+							  const Pipeline &pipeline = Pipeline()) const
+	{
+		std::string result(measure(v, styles, pipeline), '\0');
+		result.resize(writeTo(&result[0], result.size(), v, styles, pipeline));
+		return result;
+	}
+
+	virtual ~WriteBehavior() = default;
+};
+
+// Characters of a signed integer as operator<< prints it.
+inline size_t decimalLength(long long value)
+{
+	size_t n = value < 0 ? 2 : 1;
+	for (unsigned long long rest = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+		 rest >= 10; rest /= 10)
+		++n;
+	return n;
+}
+
+// Timestamp layouts. put() writes one time value and length() gives its size without writing it;
+// the layout is fixed at compile time.
+template < char Separator > struct ClockStamp
+{
+	// HH:MM:SS<Separator>mmm, hours widening past 99 as with "%02lld". Writes into buffer, which
+	// must hold 32 bytes, and returns the length.
+	static size_t format(char *buffer, Structures::Ticks ms)
+	{
+		if (ms < 0)
+			return sprintf(buffer, "%02lld:%02d:%02d%c%03d", (long long)(ms / 3600000), (int)(ms % 3600000 / 60000),
+						   (int)(ms % 60000 / 1000), Separator, (int)(ms % 1000));
+		char reversed[32];
+		char *end = reversed + sizeof(reversed);
+		char *p = end;
+		digits(p, ms % 1000, 3);
+		*--p = Separator;
+		digits(p, ms / 1000 % 60, 2);
+		*--p = ':';
+		digits(p, ms / 60000 % 60, 2);
+		*--p = ':';
+		Structures::Ticks hours = ms / 3600000;
+		digits(p, hours % 100, 2);
+		for (hours /= 100; hours > 0; hours /= 10)
+			*--p = (char)('0' + hours % 10);
+		memcpy(buffer, p, end - p);
+		return end - p;
+	}
+
+	static void put(std::ostream &out, Structures::Ticks ms)
+	{
+		char buffer[32];
+		out.write(buffer, format(buffer, ms));
+	}
+
+	static size_t length(Structures::Ticks ms)
+	{
+		if (ms < 0)
 		{
-			out << i + 1 << "\n";
-			out << timeFormat(v[i].time.start, ',') << " --> " << timeFormat(v[i].time.end, ',') << "\n";
-			out << v[i].dialogue << "\n\n";
+			char buffer[32];
+			return format(buffer, ms);
 		}
+		return 10 + std::max< size_t >(2, decimalLength(ms / 3600000));
+	}
+
+  private:
+	static void digits(char *&p, Structures::Ticks value, int width)
+	{
+		for (int i = 0; i < width; ++i, value /= 10)
+			*--p = (char)('0' + value % 10);
 	}
 };
 
-class toSAMI : public WriteBehavior
+struct MillisecondStamp
 {
-  public:
-	void write(std::ostream &out, const DynamicArray< Structures::Node > &v) override
+	static void put(std::ostream &out, Structures::Ticks ms) { out << ms; }
+	static size_t length(Structures::Ticks ms) { return decimalLength(ms); }
+};
+
+// Format policies: static header, cue and footer written for one layout. Dialogue goes out through
+// the pipeline untouched by the writer; none of the formats escapes it, as wrap() adds real markup.
+struct SRTFormat
+{
+	typedef ClockStamp< ',' > Stamp;
+	static const bool numbered = true;
+
+	static void header(std::ostream &, const Structures::StyleSheet &) {}
+
+	static void cue(std::ostream &out, size_t index, const Structures::Node &node, const Structures::Time &t,
+					const Structures::StyleSheet &, const Pipeline &pipeline)
+	{
+		out << index << "\n";
+		Stamp::put(out, t.start);
+		out << " --> ";
+		Stamp::put(out, t.end);
+		out << "\n";
+		pipeline.emit(out, node.dialogue);
+		out << "\n\n";
+	}
+
+	static size_t cueLength(size_t index, const Structures::Node &node, const Structures::Time &t,
+							const Structures::StyleSheet &, const Pipeline &pipeline)
+	{
+		return decimalLength((long long)index) + 1 + Stamp::length(t.start) + 5 + Stamp::length(t.end) + 1 +
+			   pipeline.length(node.dialogue) + 2;
+	}
+
+	static void footer(std::ostream &) {}
+};
+
+struct SAMIFormat
+{
+	typedef MillisecondStamp Stamp;
+	static const bool numbered = false;
+
+	// Only a line that still carries "<P" after stripping is written without its own paragraph.
+	static bool hasParagraph(const Structures::Text &dialogue, const TextTransform &transform)
+	{
+		static const char tag[] = "<P";
+		const char *end = dialogue.data() + dialogue.size();
+		if (std::search(dialogue.data(), end, tag, tag + 2) == end)
+			return false;
+		return !transform.strips() || transform.apply(dialogue).find("<P") != std::string::npos;
+	}
+
+	static void header(std::ostream &out, const Structures::StyleSheet &)
 	{
 		out << "<SAMI>\n";
 		out << "<BODY>\n";
-		for (size_t i = 0; i < v.size(); ++i)
+	}
+
+	static void cue(std::ostream &out, size_t, const Structures::Node &node, const Structures::Time &t,
+					const Structures::StyleSheet &, const Pipeline &pipeline)
+	{
+		out << "<SYNC Start=";
+		Stamp::put(out, t.start);
+		out << " End=";
+		Stamp::put(out, t.end);
+		out << ">\n";
+		if (hasParagraph(node.dialogue, pipeline.getText()))
+		{
+			pipeline.emit(out, node.dialogue);
+			out << "\n";
+		}
+		else
 		{
-			out << "<SYNC Start=" << v[i].time.start << " End=" << v[i].time.end << ">\n";
-			if (v[i].dialogue.find("<P") != std::string::npos)
-				out << v[i].dialogue << "\n";
-			else
-				out << "<P>" << v[i].dialogue << "</P>\n";
+			out << "<P>";
+			pipeline.emit(out, node.dialogue);
+			out << "</P>\n";
 		}
+	}
+
+	static size_t cueLength(size_t, const Structures::Node &node, const Structures::Time &t,
+							const Structures::StyleSheet &, const Pipeline &pipeline)
+	{
+		const size_t paragraph = hasParagraph(node.dialogue, pipeline.getText()) ? 1 : 8;
+		return 12 + Stamp::length(t.start) + 5 + Stamp::length(t.end) + 2 + pipeline.length(node.dialogue) + paragraph;
+	}
+
+	static void footer(std::ostream &out)
+	{
 		out << "</BODY>\n";
 		out << "</SAMI>\n";
 	}
 };
 
-class toSSA : public WriteBehavior
+struct SSAFormat
 {
-  public:
-	void write(std::ostream &out, const DynamicArray< Structures::Node > &v) override
+	typedef ClockStamp< '.' > Stamp;
+	static const bool numbered = false;
+
+	static const std::string &styleName(const Structures::StyleSheet &styles, int id)
+	{
+		return styles.styles.name(id < styles.styles.size() ? id : 0);
+	}
+
+	static const std::string &actorName(const Structures::StyleSheet &styles, int id)
+	{
+		return styles.actors.name(id < styles.actors.size() ? id : 0);
+	}
+
+	// A parsed style sheet is written back verbatim together with ASS v4+ events, so scripts round-trip.
+	static const std::string &layoutFields(const Structures::StyleSheet &styles, int id)
+	{
+		return styles.layouts.name(id < styles.layouts.size() ? id : 0);
+	}
+
+	static void header(std::ostream &out, const Structures::StyleSheet &styles)
 	{
 		out << "[Script Info]\n";
-		out << "Title: Converted Subtitle\n";
-		out << "ScriptType: v4.00+\n";
-		out << "Collisions: Normal\n\n";
+		if (styles.scriptInfo.size() != 0)
+		{
+			for (const auto &line : styles.scriptInfo)
+				out << line << "\n";
+			out << "\n";
+		}
+		else
+		{
+			out << "Title: Converted Subtitle\n";
+			out << "ScriptType: v4.00+\n";
+			out << "Collisions: Normal\n\n";
+		}
 
 		out << "[V4+ Styles]\n";
-		out << "Format: Name, Fontname, Fontsize, PrimaryColour, BackColour, Bold, Italic, Alignment, MarginL, "
-			   "MarginR, MarginV, Encoding\n";
-		out << "Style: Default,Arial,20,&H00FFFFFF,&H00000000,0,0,2,10,10,10,0\n\n";
+		if (styles.isParsed())
+		{
+			out << styles.format << "\n";
+			for (const auto &definition : styles.definitions)
+			{
+				if (!definition.empty())
+					out << definition << "\n";
+			}
+			out << "\n";
+		}
+		else
+		{
+			out << "Format: Name, Fontname, Fontsize, PrimaryColour, BackColour, Bold, Italic, Alignment, MarginL, "
+				   "MarginR, MarginV, Encoding\n";
+			out << "Style: Default,Arial,20,&H00FFFFFF,&H00000000,0,0,2,10,10,10,0\n\n";
+		}
 
 		out << "[Events]\n";
-		out << "Format: Marked, Start, End, Style, Name, MarginL, MarginR, MarginV, Text\n";
+		if (styles.isParsed())
+			out << "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n";
+		else
+			out << "Format: Marked, Start, End, Style, Name, MarginL, MarginR, MarginV, Text\n";
+	}
 
-		for (const auto &node : v)
-		{
-			out << "Dialogue: Marked=0," << timeFormat(node.time.start, '.') << "," << timeFormat(node.time.end, '.')
-				<< ",Default,,0,0,0," << node.dialogue << "\n";
-		}
+	static void cue(std::ostream &out, size_t, const Structures::Node &node, const Structures::Time &t,
+					const Structures::StyleSheet &styles, const Pipeline &pipeline)
+	{
+		if (styles.isParsed())
+			out << "Dialogue: " << t.layer << ",";
+		else
+			out << "Dialogue: Marked=0,";
+		Stamp::put(out, t.start);
+		out << ",";
+		Stamp::put(out, t.end);
+		out << "," << styleName(styles, node.style) << "," << actorName(styles, node.actor);
+		if (styles.isParsed())
+			out << "," << layoutFields(styles, node.layout) << ",";
+		else
+			out << ",0,0,0,";
+		pipeline.emit(out, node.dialogue);
+		out << "\n";
+	}
+
+	static size_t cueLength(size_t, const Structures::Node &node, const Structures::Time &t,
+							const Structures::StyleSheet &styles, const Pipeline &pipeline)
+	{
+		const size_t lead = styles.isParsed() ? 10 + decimalLength(t.layer) + 1 : 19;
+		const size_t fields = styles.isParsed() ? layoutFields(styles, node.layout).size() + 2 : 7;
+		return lead + Stamp::length(t.start) + 1 + Stamp::length(t.end) + 1 + styleName(styles, node.style).size() + 1 +
+			   actorName(styles, node.actor).size() + fields + pipeline.length(node.dialogue) + 1;
 	}
+
+	static void footer(std::ostream &) {}
 };
 
-class toTTML : public WriteBehavior
+struct TTMLFormat
 {
-  public:
-	void write(std::ostream &out, const DynamicArray< Structures::Node > &v) override
+	typedef ClockStamp< '.' > Stamp;
+	static const bool numbered = false;
+
+	static void header(std::ostream &out, const Structures::StyleSheet &)
 	{
 		out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
 		out << "<tt xmlns=\"http://www.w3.org/ns/ttml\">\n";
 		out << "<body>\n";
 		out << "<div>\n";
+	}
 
-		for (size_t i = 0; i < v.size(); ++i)
-		{
-			out << "<p begin=\"" << timeFormat(v[i].time.start, '.') << "\" end=\"" << timeFormat(v[i].time.end, '.') << "\">";
-			out << v[i].dialogue;
-			out << "</p>\n";
-		}
+	static void cue(std::ostream &out, size_t, const Structures::Node &node, const Structures::Time &t,
+					const Structures::StyleSheet &, const Pipeline &pipeline)
+	{
+		out << "<p begin=\"";
+		Stamp::put(out, t.start);
+		out << "\" end=\"";
+		Stamp::put(out, t.end);
+		out << "\">";
+		pipeline.emit(out, node.dialogue);
+		out << "</p>\n";
+	}
+
+	static size_t cueLength(size_t, const Structures::Node &node, const Structures::Time &t,
+							const Structures::StyleSheet &, const Pipeline &pipeline)
+	{
+		return 10 + Stamp::length(t.start) + 7 + Stamp::length(t.end) + 2 + pipeline.length(node.dialogue) + 5;
+	}
 
+	static void footer(std::ostream &out)
+	{
 		out << "</div>\n";
 		out << "</body>\n";
 		out << "</tt>\n";
 	}
 };
 
+struct VTTFormat
+{
+	typedef ClockStamp< '.' > Stamp;
+	static const bool numbered = false;
+
+	static void header(std::ostream &out, const Structures::StyleSheet &) { out << "WEBVTT\n\n"; }
+
+	static void cue(std::ostream &out, size_t, const Structures::Node &node, const Structures::Time &t,
+					const Structures::StyleSheet &, const Pipeline &pipeline)
+	{
+		Stamp::put(out, t.start);
+		out << " --> ";
+		Stamp::put(out, t.end);
+		out << "\n";
+		pipeline.emit(out, node.dialogue);
+		out << "\n\n";
+	}
+
+	static size_t cueLength(size_t, const Structures::Node &node, const Structures::Time &t,
+							const Structures::StyleSheet &, const Pipeline &pipeline)
+	{
+		return Stamp::length(t.start) + 5 + Stamp::length(t.end) + 1 + pipeline.length(node.dialogue) + 2;
+	}
+
+	static void footer(std::ostream &) {}
+};
+
+// WriteBehavior for one format policy. The per-cue loop calls the policy directly, so it is
+// specialized and inlined per format; only the calls into writeRange go through the vtable.
+template < typename Format > class FormatWriter final : public WriteBehavior
+{
+  protected:
+	void header(std::ostream &out, const Structures::StyleSheet &styles) const override { Format::header(out, styles); }
+
+	void footer(std::ostream &out) const override { Format::footer(out); }
+
+	void writeRange(std::ostream &out, const DynamicArray< Structures::Node > &v, int from, int to, size_t first,
+					const Structures::StyleSheet &styles, const Pipeline &pipeline) const override
+	{
+		Structures::Time t;
+		for (int i = from; i < to; ++i)
+		{
+			if (pipeline.accept(v[i], t))
+				Format::cue(out, ++first, v[i], t, styles, pipeline);
+		}
+	}
+
+	size_t measureRange(const DynamicArray< Structures::Node > &v, int from, int to, size_t first,
+						const Structures::StyleSheet &styles, const Pipeline &pipeline) const override
+	{
+		size_t bytes = 0;
+		Structures::Time t;
+		for (int i = from; i < to; ++i)
+		{
+			if (pipeline.accept(v[i], t))
+				bytes += Format::cueLength(++first, v[i], t, styles, pipeline);
+		}
+		return bytes;
+	}
+
+	bool numbered() const override { return Format::numbered; }
+};
+
+typedef FormatWriter< SRTFormat > toSRT;
+typedef FormatWriter< SAMIFormat > toSAMI;
+typedef FormatWriter< SSAFormat > toSSA;
+typedef FormatWriter< TTMLFormat > toTTML;
+typedef FormatWriter< VTTFormat > toVTT;
+
 #endif
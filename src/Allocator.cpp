@@ -0,0 +1,143 @@
+#include "Allocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace
+{
+class NewDeleteAllocator : public Allocator
+{
+public:
+  void* allocate(size_t bytes, size_t) override { return ::operator new(bytes); }
+  void deallocate(void* p, size_t, size_t) override { ::operator delete(p); }
+};
+
+const size_t slabBytes = 64 * 1024;
+}
+
+Allocator* Allocator::standard()
+{
+  static NewDeleteAllocator instance;
+  return &instance;
+}
+
+MonotonicArena::MonotonicArena(size_t initialBlock, Allocator* up) : upstream(up), nextBlock(std::max< size_t >(initialBlock, 64)) {}
+
+MonotonicArena::~MonotonicArena() { release(); }
+
+void* MonotonicArena::allocate(size_t bytes, size_t alignment)
+{
+  size_t padding = (alignment - (uintptr_t)cursor % alignment) % alignment;
+  if (padding + bytes > left)
+  {
+    const size_t size = std::max(nextBlock, bytes + alignment);
+    cursor = static_cast< char* >(upstream->allocate(size, alignof(std::max_align_t)));
+    blocks.push_back(std::make_pair((void*)cursor, size));
+    reserved += size;
+    left = size;
+    nextBlock = size * 2;
+    padding = (alignment - (uintptr_t)cursor % alignment) % alignment;
+  }
+  char* p = cursor + padding;
+  cursor = p + bytes;
+  left -= padding + bytes;
+  return p;
+}
+
+void MonotonicArena::reserve(size_t bytes)
+{
+  if (bytes <= left)
+    return;
+  const size_t size = std::max(nextBlock, bytes);
+  cursor = static_cast< char* >(upstream->allocate(size, alignof(std::max_align_t)));
+  blocks.push_back(std::make_pair((void*)cursor, size));
+  reserved += size;
+  left = size;
+  nextBlock = size * 2;
+}
+
+void MonotonicArena::release()
+{
+  for (const auto& block : blocks)
+    upstream->deallocate(block.first, block.second, alignof(std::max_align_t));
+  blocks.clear();
+  reserved = 0;
+  cursor = nullptr;
+  left = 0;
+}
+
+PoolAllocator::PoolAllocator(Allocator* up) : upstream(up) {}
+
+PoolAllocator::~PoolAllocator()
+{
+  for (const auto& slab : slabs)
+    upstream->deallocate(slab.first, slab.second, alignof(std::max_align_t));
+}
+
+int PoolAllocator::classOf(size_t bytes)
+{
+  int c = 0;
+  size_t size = smallest;
+  while (size < bytes && c < classCount)
+  {
+    size *= 2;
+    ++c;
+  }
+  return c;
+}
+
+void* PoolAllocator::allocate(size_t bytes, size_t alignment)
+{
+  const int c = classOf(bytes);
+  if (c >= classCount || alignment > alignof(std::max_align_t))
+    return upstream->allocate(bytes, alignment);
+
+  std::lock_guard< std::mutex > guard(lock);
+  if (!freeLists[c])
+  {
+    // Small classes are carved out of one slab; large ones take a slab each.
+    const size_t size = smallest << c;
+    const size_t count = std::max< size_t >(1, slabBytes / size);
+    char* slab = static_cast< char* >(upstream->allocate(size * count, alignof(std::max_align_t)));
+    slabs.push_back(std::make_pair((void*)slab, size * count));
+    for (size_t i = count; i-- > 0;)
+    {
+      FreeBlock* block = reinterpret_cast< FreeBlock* >(slab + i * size);
+      block->next = freeLists[c];
+      freeLists[c] = block;
+    }
+  }
+  FreeBlock* block = freeLists[c];
+  freeLists[c] = block->next;
+  return block;
+}
+
+void PoolAllocator::deallocate(void* p, size_t bytes, size_t alignment)
+{
+  if (!p)
+    return;
+  const int c = classOf(bytes);
+  if (c >= classCount || alignment > alignof(std::max_align_t))
+  {
+    upstream->deallocate(p, bytes, alignment);
+    return;
+  }
+  std::lock_guard< std::mutex > guard(lock);
+  FreeBlock* block = static_cast< FreeBlock* >(p);
+  block->next = freeLists[c];
+  freeLists[c] = block;
+}
+
+size_t PoolAllocator::slabCount()
+{
+  std::lock_guard< std::mutex > guard(lock);
+  return slabs.size();
+}
+
+PoolAllocator& PoolAllocator::shared()
+{
+  // Never destroyed, so arrays in other static objects can still give their memory back.
+  static PoolAllocator* instance = new PoolAllocator();
+  return *instance;
+}
@@ -0,0 +1,223 @@
+#include "BatchConverter.h"
+
+#include "Encoding.h"
+#include "SubtitleFactory.h"
+#include "Transcode.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+std::string extensionOf(const std::string& path)
+{
+  const size_t dot = path.rfind('.');
+  return dot == std::string::npos ? "" : path.substr(dot);
+}
+}
+
+struct BatchConverter::Document
+{
+  ConversionJob job;
+  const SubtitleFormat* source = nullptr;
+  const SubtitleFormat* target = nullptr;
+  std::vector< std::unique_ptr< Subtitle > > parts;
+  // Tasks left in the current phase: chunk parses, then range writes.
+  std::atomic< int > remaining{ 0 };
+
+  // Write phase: the merged cues, serialized as ranges of perRange cues into pieces.
+  std::unique_ptr< Subtitle > merged;
+  std::unique_ptr< WriteBehavior > writer;
+  int perRange = 0;
+  std::vector< size_t > first;
+  std::vector< std::string > pieces;
+  std::atomic< bool > failed{ false };
+};
+
+BatchConverter::BatchConverter(unsigned threads, size_t chunkBytes, bool stealing)
+  : chunkSize(chunkBytes), scheduler(threads, stealing)
+{
+}
+
+int BatchConverter::convert(const std::vector< ConversionJob >& jobs)
+{
+  scheduler.resetStats();
+  failures.clear();
+  for (const auto& job : jobs)
+  {
+    scheduler.submit([this, job]() { open(job); });
+  }
+  scheduler.wait();
+  return (int)(jobs.size() - failures.size());
+}
+
+void BatchConverter::fail(const std::string& path)
+{
+  std::lock_guard< std::mutex > guard(failureLock);
+  failures.push_back(path);
+}
+
+void BatchConverter::open(const ConversionJob& job)
+{
+  // Both formats are resolved once; every chunk and the final write reuse the rows.
+  const SubtitleFormat* source = SubtitleFactory::find(extensionOf(job.input));
+  const SubtitleFormat* target = SubtitleFactory::find(extensionOf(job.output));
+  std::ifstream in(job.input, std::ios::binary);
+  if (!source || !target || !in.is_open())
+  {
+    fail(job.input);
+    return;
+  }
+
+  std::unique_ptr< Subtitle > probe = source->create();
+  std::shared_ptr< Document > doc = std::make_shared< Document >();
+  doc->job = job;
+  doc->source = source;
+  doc->target = target;
+  try
+  {
+    const std::string text = Encoding::readUtf8(in);
+    DynamicArray< std::string > chunks = probe->split(text, chunkSize);
+    if (chunks.size() <= 1)
+    {
+      const Transcode::Path direct = Transcode::find(source, target);
+      std::string converted;
+      if (direct && direct(text, converted))
+      {
+        std::ofstream out(job.output, std::ios::binary);
+        out.write(converted.data(), converted.size());
+        out.close();
+        if (!out)
+          fail(job.input);
+        return;
+      }
+      probe->bufferParse(text);
+      doc->parts.push_back(std::move(probe));
+      finish(doc);
+      return;
+    }
+
+    doc->remaining = chunks.size();
+    for (int i = 0; i < chunks.size(); ++i)
+      doc->parts.push_back(source->create());
+    for (int i = 0; i < chunks.size(); ++i)
+    {
+      std::shared_ptr< std::string > chunk = std::make_shared< std::string >(std::move(chunks[i]));
+      scheduler.submit([this, doc, i, chunk]() {
+        try
+        {
+          doc->parts[i]->bufferParse(*chunk);
+        }
+        catch (const std::exception&)
+        {
+          doc->parts[i].reset();
+        }
+        if (--doc->remaining == 0)
+          scheduler.submit([this, doc]() { finish(doc); });
+      });
+    }
+  }
+  catch (const std::exception&)
+  {
+    fail(job.input);
+  }
+}
+
+void BatchConverter::finish(const std::shared_ptr< Document >& doc)
+{
+  std::unique_ptr< Subtitle > target = doc->target->create();
+  DynamicArray< const Subtitle* > sources;
+  for (const auto& part : doc->parts)
+  {
+    if (!part)
+      target.reset();
+    else
+      sources.push_back(part.get());
+  }
+  if (!target)
+  {
+    fail(doc->job.input);
+    return;
+  }
+  try
+  {
+    target->merge(sources);
+    target->normalize();
+  }
+  catch (const std::exception&)
+  {
+    fail(doc->job.input);
+    return;
+  }
+  // Merged nodes keep their text alive through the arenas, so the parsed chunks can go.
+  doc->parts.clear();
+  doc->merged = std::move(target);
+  doc->writer = doc->target->makeWriter();
+
+  // As many ranges as the input had chunks, so a small file is written by this task alone.
+  const DynamicArray< Structures::Node >& cues = doc->merged->getContents();
+  const int ranges = std::max(1, std::min((int)sources.size(), cues.size()));
+  doc->perRange = (cues.size() + ranges - 1) / ranges;
+  doc->first.assign(ranges, 0);
+  doc->pieces.resize(ranges);
+  if (doc->writer->isNumbered())
+  {
+    size_t kept = 0;
+    for (int r = 0; r < ranges; ++r)
+    {
+      doc->first[r] = kept;
+      kept += doc->writer->kept(cues, r * doc->perRange, std::min(cues.size(), (r + 1) * doc->perRange), Pipeline());
+    }
+  }
+  if (ranges == 1)
+  {
+    writePiece(doc, 0);
+    save(doc);
+    return;
+  }
+  doc->remaining = ranges;
+  for (int r = 0; r < ranges; ++r)
+  {
+    scheduler.submit([this, doc, r]() {
+      writePiece(doc, r);
+      if (--doc->remaining == 0)
+        save(doc);
+    });
+  }
+}
+
+void BatchConverter::writePiece(const std::shared_ptr< Document >& doc, int range)
+{
+  const DynamicArray< Structures::Node >& cues = doc->merged->getContents();
+  try
+  {
+    std::ostringstream piece;
+    doc->writer->writePart(piece, cues, range * doc->perRange, std::min(cues.size(), (range + 1) * doc->perRange),
+                           doc->first[range], doc->merged->getStyles(), Pipeline());
+    doc->pieces[range] = piece.str();
+  }
+  catch (const std::exception&)
+  {
+    doc->failed = true;
+  }
+}
+
+void BatchConverter::save(const std::shared_ptr< Document >& doc)
+{
+  if (doc->failed)
+  {
+    fail(doc->job.input);
+    return;
+  }
+  std::ofstream out(doc->job.output);
+  doc->writer->writeHeader(out, doc->merged->getStyles());
+  for (const auto& piece : doc->pieces)
+    out.write(piece.data(), piece.size());
+  doc->writer->writeFooter(out);
+  out.close();
+  if (!out)
+    fail(doc->job.input);
+}
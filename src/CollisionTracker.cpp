@@ -0,0 +1,345 @@
+#include "CollisionTracker.h"
+
+#include <algorithm>
+
+CollisionTracker::CollisionTracker(const DynamicArray< Structures::Node > &nodes)
+{
+	entries.reserve(nodes.size());
+	neighbours.reserve(nodes.size());
+	for (const auto &node : nodes)
+	{
+		insert(node.time);
+	}
+}
+
+unsigned CollisionTracker::nextPriority()
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+bool CollisionTracker::less(int a, int b) const
+{
+	const Structures::Time &x = entries[a].time;
+	const Structures::Time &y = entries[b].time;
+	return x.start < y.start || (x.start == y.start && a < b);
+}
+
+void CollisionTracker::update(int t)
+{
+	Entry &e = entries[t];
+	e.maxEnd = e.time.end;
+	for (int child : { e.left, e.right })
+	{
+		if (child == -1)
+			continue;
+		entries[child].parent = t;
+		e.maxEnd = std::max(e.maxEnd, entries[child].maxEnd + e.lazy);
+	}
+}
+
+void CollisionTracker::apply(int t, Structures::Ticks delta)
+{
+	if (t == -1)
+		return;
+	Entry &e = entries[t];
+	e.time.start += delta;
+	e.time.end += delta;
+	e.maxEnd += delta;
+	e.lazy += delta;
+}
+
+void CollisionTracker::push(int t)
+{
+	Entry &e = entries[t];
+	if (e.lazy == 0)
+		return;
+	apply(e.left, e.lazy);
+	apply(e.right, e.lazy);
+	e.lazy = 0;
+}
+
+int CollisionTracker::rooted(int t)
+{
+	if (t != -1)
+		entries[t].parent = -1;
+	return t;
+}
+
+void CollisionTracker::setRoot(int layer, int t)
+{
+	if (t == -1)
+		roots.erase(layer);
+	else
+		roots[layer] = rooted(t);
+}
+
+void CollisionTracker::split(int t, int key, int &l, int &r)
+{
+	if (t == -1)
+	{
+		l = r = -1;
+		return;
+	}
+	push(t);
+	if (less(t, key))
+	{
+		split(entries[t].right, key, entries[t].right, r);
+		l = t;
+	}
+	else
+	{
+		split(entries[t].left, key, l, entries[t].left);
+		r = t;
+	}
+	update(t);
+}
+
+void CollisionTracker::splitStart(int t, Structures::Ticks start, int &l, int &r)
+{
+	if (t == -1)
+	{
+		l = r = -1;
+		return;
+	}
+	push(t);
+	if (entries[t].time.start < start)
+	{
+		splitStart(entries[t].right, start, entries[t].right, r);
+		l = t;
+	}
+	else
+	{
+		splitStart(entries[t].left, start, l, entries[t].left);
+		r = t;
+	}
+	update(t);
+}
+
+int CollisionTracker::merge(int l, int r)
+{
+	if (l == -1)
+		return r;
+	if (r == -1)
+		return l;
+	if (entries[l].priority > entries[r].priority)
+	{
+		push(l);
+		entries[l].right = merge(entries[l].right, r);
+		update(l);
+		return l;
+	}
+	push(r);
+	entries[r].left = merge(l, entries[r].left);
+	update(r);
+	return r;
+}
+
+// Union of two treaps whose keys may interleave; when they do not, only one path is walked.
+int CollisionTracker::unite(int a, int b)
+{
+	if (a == -1)
+		return b;
+	if (b == -1)
+		return a;
+	if (entries[a].priority < entries[b].priority)
+		std::swap(a, b);
+	push(a);
+	int l, r;
+	split(b, a, l, r);
+	entries[a].left = unite(entries[a].left, l);
+	entries[a].right = unite(entries[a].right, r);
+	update(a);
+	return a;
+}
+
+Structures::Time CollisionTracker::trueTime(int id) const
+{
+	Structures::Time t = entries[id].time;
+	for (int p = entries[id].parent; p != -1; p = entries[p].parent)
+	{
+		t.start += entries[p].lazy;
+		t.end += entries[p].lazy;
+	}
+	return t;
+}
+
+void CollisionTracker::attach(int id)
+{
+	entries[id].left = entries[id].right = -1;
+	entries[id].lazy = 0;
+	update(id);
+	const int layer = entries[id].time.layer;
+	auto it = roots.find(layer);
+	int l, r;
+	split(it == roots.end() ? -1 : it->second, id, l, r);
+	setRoot(layer, merge(merge(l, id), r));
+}
+
+void CollisionTracker::detach(int id)
+{
+	DynamicArray< int > path;
+	for (int p = entries[id].parent; p != -1; p = entries[p].parent)
+		path.push_back(p);
+	for (int i = path.size() - 1; i >= 0; --i)
+		push(path[i]);
+	push(id);
+
+	const int replacement = merge(entries[id].left, entries[id].right);
+	if (path.size() == 0)
+	{
+		setRoot(entries[id].time.layer, replacement);
+		return;
+	}
+	Entry &parent = entries[path[0]];
+	(parent.left == id ? parent.left : parent.right) = replacement;
+	for (int p : path)
+		update(p);
+}
+
+void CollisionTracker::link(int a, int b)
+{
+	collisions.insert(std::minmax(a, b));
+	neighbours[a].insert(b);
+	neighbours[b].insert(a);
+}
+
+void CollisionTracker::unlink(int id)
+{
+	for (int other : neighbours[id])
+	{
+		neighbours[other].erase(id);
+		collisions.erase(std::minmax(id, other));
+	}
+	neighbours[id].clear();
+}
+
+void CollisionTracker::connect(int id)
+{
+	DynamicArray< int > found;
+	const Structures::Time q = trueTime(id);
+	overlapping(roots[q.layer], q, id, 0, found);
+	for (int other : found)
+	{
+		link(id, other);
+	}
+}
+
+// Cues of subtree t other than id that intersect q; offset is the shift still held by t's ancestors.
+void CollisionTracker::overlapping(int t, const Structures::Time &q, int id, Structures::Ticks offset,
+								   DynamicArray< int > &out) const
+{
+	if (t == -1 || entries[t].maxEnd + offset <= q.start)
+		return;
+	const Structures::Ticks below = offset + entries[t].lazy;
+	overlapping(entries[t].left, q, id, below, out);
+	if (entries[t].time.start + offset < q.end)
+	{
+		if (t != id && q.start < entries[t].time.end + offset)
+			out.push_back(t);
+		overlapping(entries[t].right, q, id, below, out);
+	}
+}
+
+int CollisionTracker::insert(const Structures::Time &t)
+{
+	const int id = (int)entries.size();
+	entries.push_back(Entry());
+	neighbours.push_back(std::set< int >());
+	entries[id].time = t;
+	entries[id].priority = nextPriority();
+	entries[id].alive = true;
+	attach(id);
+	connect(id);
+	return id;
+}
+
+void CollisionTracker::erase(int id)
+{
+	if (!contains(id))
+		return;
+	unlink(id);
+	detach(id);
+	entries[id].alive = false;
+}
+
+void CollisionTracker::shift(int id, Structures::Ticks delta)
+{
+	if (!contains(id))
+		return;
+	unlink(id);
+	detach(id);
+	entries[id].time.start += delta;
+	entries[id].time.end += delta;
+	attach(id);
+	connect(id);
+}
+
+void CollisionTracker::shiftRange(Structures::Ticks from, Structures::Ticks to, Structures::Ticks delta)
+{
+	if (delta == 0 || from >= to)
+		return;
+	DynamicArray< int > layers;
+	for (const auto &root : roots)
+		layers.push_back(root.first);
+
+	for (int layer : layers)
+	{
+		// A pair between a moved and a fixed cue has one cue spanning from or to.
+		std::set< std::pair< int, int > > stale;
+		for (Structures::Ticks edge : { from, to })
+		{
+			DynamicArray< int > spanning;
+			overlapping(roots[layer], Structures::Time(layer, edge, edge + 1), -1, 0, spanning);
+			for (int x : spanning)
+			{
+				const Structures::Ticks start = trueTime(x).start;
+				const bool moved = from <= start && start < to;
+				if (start >= edge || (edge == to && !moved))
+					continue;
+				for (int y : neighbours[x])
+				{
+					const Structures::Ticks other = trueTime(y).start;
+					if (edge == from ? other >= from && other < to : other >= to)
+						stale.insert(std::minmax(x, y));
+				}
+			}
+		}
+		for (const auto &pair : stale)
+		{
+			collisions.erase(pair);
+			neighbours[pair.first].erase(pair.second);
+			neighbours[pair.second].erase(pair.first);
+		}
+
+		int before, rest, block, after;
+		splitStart(roots[layer], from, before, rest);
+		splitStart(rest, to, block, after);
+		const int fixed = rooted(merge(rooted(before), rooted(after)));
+		if (rooted(block) == -1)
+		{
+			setRoot(layer, fixed);
+			continue;
+		}
+		apply(block, delta);
+
+		// Fixed cues overlapping the block's new span, each checked against the block.
+		DynamicArray< int > near;
+		overlapping(fixed, Structures::Time(layer, from + delta, entries[block].maxEnd), -1, 0, near);
+		for (int x : near)
+		{
+			DynamicArray< int > hits;
+			overlapping(block, trueTime(x), -1, 0, hits);
+			for (int b : hits)
+				link(x, b);
+		}
+		setRoot(layer, unite(fixed, block));
+	}
+}
+
+bool CollisionTracker::collides(int a, int b) const
+{
+	return collisions.count(std::minmax(a, b)) != 0;
+}
@@ -0,0 +1,316 @@
+#include "Encoding.h"
+
+#include "CodePages.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ENCODING_SSE2
+#endif
+
+namespace
+{
+const uint32_t replacement = 0xFFFD;
+
+void appendUtf8(uint32_t cp, std::string& out)
+{
+  if (cp < 0x80)
+  {
+    out += (char)cp;
+  }
+  else if (cp < 0x800)
+  {
+    out += (char)(0xC0 | (cp >> 6));
+    out += (char)(0x80 | (cp & 0x3F));
+  }
+  else if (cp < 0x10000)
+  {
+    out += (char)(0xE0 | (cp >> 12));
+    out += (char)(0x80 | ((cp >> 6) & 0x3F));
+    out += (char)(0x80 | (cp & 0x3F));
+  }
+  else
+  {
+    out += (char)(0xF0 | (cp >> 18));
+    out += (char)(0x80 | ((cp >> 12) & 0x3F));
+    out += (char)(0x80 | ((cp >> 6) & 0x3F));
+    out += (char)(0x80 | (cp & 0x3F));
+  }
+}
+
+inline uint32_t unitAt(const unsigned char* p, bool bigEndian)
+{
+  return bigEndian ? (p[0] << 8 | p[1]) : (p[1] << 8 | p[0]);
+}
+
+size_t decodeUtf16(const unsigned char* p, size_t n, bool bigEndian, bool last, std::string& out)
+{
+  size_t i = 0;
+  while (i + 2 <= n)
+  {
+#ifdef ENCODING_SSE2
+    // Eight ASCII code units at a time become eight bytes.
+    while (i + 16 <= n)
+    {
+      __m128i units = _mm_loadu_si128(reinterpret_cast< const __m128i* >(p + i));
+      if (bigEndian)
+        units = _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+      const __m128i high = _mm_and_si128(units, _mm_set1_epi16((short)0xFF80));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xFFFF)
+        break;
+      char ascii[16];
+      _mm_storeu_si128(reinterpret_cast< __m128i* >(ascii), _mm_packus_epi16(units, units));
+      out.append(ascii, 8);
+      i += 16;
+    }
+    if (i + 2 > n)
+      break;
+#endif
+    const uint32_t unit = unitAt(p + i, bigEndian);
+    if (unit >= 0xD800 && unit < 0xDC00)
+    {
+      if (i + 4 > n)
+      {
+        if (!last)
+          break;
+        appendUtf8(replacement, out);
+        i += 2;
+        continue;
+      }
+      const uint32_t low = unitAt(p + i + 2, bigEndian);
+      if (low >= 0xDC00 && low < 0xE000)
+      {
+        appendUtf8(0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00), out);
+        i += 4;
+        continue;
+      }
+      appendUtf8(replacement, out);
+    }
+    else if (unit >= 0xDC00 && unit < 0xE000)
+    {
+      appendUtf8(replacement, out);
+    }
+    else
+    {
+      appendUtf8(unit, out);
+    }
+    i += 2;
+  }
+  if (last && i < n)
+  {
+    appendUtf8(replacement, out);
+    i = n;
+  }
+  return i;
+}
+
+size_t decodeSingleByte(const unsigned char* p, size_t n, const uint16_t* table, std::string& out)
+{
+  for (size_t i = 0; i < n; ++i)
+  {
+    if (p[i] < 0x80)
+      out += (char)p[i];
+    else
+      appendUtf8(table[p[i] - 0x80], out);
+  }
+  return n;
+}
+
+size_t decodeCP949(const unsigned char* p, size_t n, bool last, std::string& out)
+{
+  size_t i = 0;
+  while (i < n)
+  {
+    const unsigned char lead = p[i];
+    if (lead < 0x80)
+    {
+      out += (char)lead;
+      ++i;
+      continue;
+    }
+    if (lead < CodePages::cp949LeadFirst || lead == 0xFF)
+    {
+      appendUtf8(replacement, out);
+      ++i;
+      continue;
+    }
+    if (i + 1 >= n)
+    {
+      if (!last)
+        break;
+      appendUtf8(replacement, out);
+      ++i;
+      continue;
+    }
+    const unsigned char trail = p[i + 1];
+    if (trail < CodePages::cp949TrailFirst || trail == 0xFF)
+    {
+      appendUtf8(replacement, out);
+      ++i;
+      continue;
+    }
+    const int index = (lead - CodePages::cp949LeadFirst) * CodePages::cp949TrailCount +
+                      (trail - CodePages::cp949TrailFirst);
+    appendUtf8(CodePages::cp949[index], out);
+    i += 2;
+  }
+  return i;
+}
+
+size_t bomFor(Encoding::Charset charset, const unsigned char* p, size_t n)
+{
+  if (charset == Encoding::Charset::UTF8 && n >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF)
+    return 3;
+  if (charset == Encoding::Charset::UTF16LE && n >= 2 && p[0] == 0xFF && p[1] == 0xFE)
+    return 2;
+  if (charset == Encoding::Charset::UTF16BE && n >= 2 && p[0] == 0xFE && p[1] == 0xFF)
+    return 2;
+  return 0;
+}
+}
+
+namespace Encoding
+{
+bool fromName(const std::string& name, Charset& charset)
+{
+  std::string key;
+  for (char c : name)
+  {
+    if (c != '-' && c != '_')
+      key += (char)tolower((unsigned char)c);
+  }
+  if (key == "utf8")
+    charset = Charset::UTF8;
+  else if (key == "utf16" || key == "utf16le")
+    charset = Charset::UTF16LE;
+  else if (key == "utf16be")
+    charset = Charset::UTF16BE;
+  else if (key == "cp1252" || key == "windows1252" || key == "latin1")
+    charset = Charset::CP1252;
+  else if (key == "cp1251" || key == "windows1251")
+    charset = Charset::CP1251;
+  else if (key == "cp949" || key == "euckr" || key == "uhc")
+    charset = Charset::CP949;
+  else if (key == "auto")
+    charset = Charset::Auto;
+  else
+    return false;
+  return true;
+}
+
+Charset sniff(const char* data, size_t n, size_t& bomLength)
+{
+  const unsigned char* p = reinterpret_cast< const unsigned char* >(data);
+  const Charset withBom[] = { Charset::UTF8, Charset::UTF16LE, Charset::UTF16BE };
+  for (Charset c : withBom)
+  {
+    bomLength = bomFor(c, p, n);
+    if (bomLength)
+      return c;
+  }
+
+  size_t evenZeros = 0;
+  size_t oddZeros = 0;
+  const size_t sample = std::min< size_t >(n, 512) & ~size_t(1);
+  for (size_t i = 0; i < sample; i += 2)
+  {
+    evenZeros += p[i] == 0;
+    oddZeros += p[i + 1] == 0;
+  }
+  if (sample && oddZeros * 4 > sample && evenZeros * 8 < sample)
+    return Charset::UTF16LE;
+  if (sample && evenZeros * 4 > sample && oddZeros * 8 < sample)
+    return Charset::UTF16BE;
+  return Charset::UTF8;
+}
+
+size_t decode(Charset charset, const char* data, size_t n, bool last, std::string& out)
+{
+  const unsigned char* p = reinterpret_cast< const unsigned char* >(data);
+  switch (charset)
+  {
+  case Charset::UTF16LE:
+    return decodeUtf16(p, n, false, last, out);
+  case Charset::UTF16BE:
+    return decodeUtf16(p, n, true, last, out);
+  case Charset::CP1252:
+    return decodeSingleByte(p, n, CodePages::cp1252, out);
+  case Charset::CP1251:
+    return decodeSingleByte(p, n, CodePages::cp1251, out);
+  case Charset::CP949:
+    return decodeCP949(p, n, last, out);
+  default:
+    out.append(data, n);
+    return n;
+  }
+}
+
+std::string toUtf8(const std::string& bytes, Charset charset)
+{
+  size_t bom = 0;
+  if (charset == Charset::Auto)
+    charset = sniff(bytes.data(), bytes.size(), bom);
+  else
+    bom = bomFor(charset, reinterpret_cast< const unsigned char* >(bytes.data()), bytes.size());
+  std::string out;
+  out.reserve(bytes.size());
+  decode(charset, bytes.data() + bom, bytes.size() - bom, true, out);
+  return out;
+}
+
+DecodingBuffer::DecodingBuffer(std::istream& in, Charset c) : source(in), charset(c), sniffed(false) {}
+
+DecodingBuffer::int_type DecodingBuffer::underflow()
+{
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+
+  decoded.clear();
+  bool last = false;
+  while (decoded.empty() && !last)
+  {
+    raw.resize(pending + chunkSize);
+    source.read(&raw[pending], chunkSize);
+    const size_t total = pending + (size_t)source.gcount();
+    last = (size_t)source.gcount() < chunkSize;
+
+    size_t offset = 0;
+    if (!sniffed)
+    {
+      if (charset == Charset::Auto)
+        charset = sniff(raw.data(), total, offset);
+      else
+        offset = bomFor(charset, reinterpret_cast< const unsigned char* >(raw.data()), total);
+      sniffed = true;
+    }
+
+    offset += decode(charset, raw.data() + offset, total - offset, last, decoded);
+    pending = total - offset;
+    memmove(&raw[0], raw.data() + offset, pending);
+  }
+
+  if (decoded.empty())
+    return traits_type::eof();
+  char* begin = &decoded[0];
+  setg(begin, begin, begin + decoded.size());
+  return traits_type::to_int_type(*gptr());
+}
+
+std::string readUtf8(std::istream& in, Charset charset)
+{
+  DecodingStream decoded(in, charset);
+  std::string text;
+  while (true)
+  {
+    const size_t size = text.size();
+    text.resize(size + DecodingBuffer::chunkSize);
+    decoded.read(&text[size], DecodingBuffer::chunkSize);
+    text.resize(size + (size_t)decoded.gcount());
+    if ((size_t)decoded.gcount() < DecodingBuffer::chunkSize)
+      return text;
+  }
+}
+}
@@ -0,0 +1,55 @@
+#include "MappedFile.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPEDFILE_MMAP 1
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile(const string& path)
+{
+#ifdef MAPPEDFILE_MMAP
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw runtime_error("Failed to open file " + path);
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0)
+  {
+    void* p = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED)
+    {
+      view = static_cast< const char* >(p);
+      length = (size_t)info.st_size;
+      mapped = true;
+    }
+  }
+  close(fd);
+  if (mapped)
+    return;
+#endif
+  // Empty files, pipes and platforms without mmap.
+  ifstream in(path, ios::binary);
+  if (!in.is_open())
+    throw runtime_error("Failed to open file " + path);
+  ostringstream buffer;
+  buffer << in.rdbuf();
+  fallback = buffer.str();
+  view = fallback.data();
+  length = fallback.size();
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef MAPPEDFILE_MMAP
+  if (mapped)
+    munmap(const_cast< char* >(view), length);
+#endif
+}
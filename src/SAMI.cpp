@@ -1,46 +1,104 @@
 #include "SAMI.h"
 
 #include "DynamicArray.h"
+#include "Scanner.h"
 
+#include <cctype>
 #include <regex>
 #include <string>
 
+using namespace std;
+
+namespace
+{
+// Offset of the first case-insensitive match of tag ("<p" or "</p>") at or after from, or n.
+size_t findTag(const char *s, size_t n, size_t from, const char *tag, size_t length)
+{
+	while (from < n)
+	{
+		from += Scanner::find(s + from, n - from, '<');
+		if (from + length > n)
+			return n;
+		size_t i = 1;
+		while (i < length && tolower((unsigned char)s[from + i]) == tag[i])
+			++i;
+		if (i == length)
+			return from;
+		++from;
+	}
+	return n;
+}
+}
+
+// Same as regex_search with <SYNC Start=(\d+)>: the first marker followed by digits and '>'.
 Structures::Time SAMI::timeParse(const string &s)
 {
 	Structures::Time t;
-	regex pattern(R"(<SYNC Start=(\d+)>)");
-	smatch match;
-	if (regex_search(s, match, pattern))
+	size_t pos = 0;
+	while ((pos = Scanner::find(s, "<SYNC Start=", 12, pos)) != string::npos)
 	{
-		t.start = stoi(match.str(1));
-		t.end = t.start;
-		return t;
+		pos += 12;
+		size_t end = pos;
+		while (end < s.size() && isdigit((unsigned char)s[end]))
+			++end;
+		if (end > pos && end < s.size() && s[end] == '>')
+		{
+			t.start = stoll(s.substr(pos, end - pos));
+			t.end = t.start;
+			return t;
+		}
 	}
 	return t;
 }
 
+// Same as regex_search with <P[^>]*>(.*?)</P>, ignoring case: the text of the first paragraph
+// that closes on its own line.
 string SAMI::dialogueParse(const string &line)
 {
-	smatch match;
-	regex pattern(R"(<P[^>]*>(.*?)<\/P>)", regex_constants::icase);
-	if (!regex_search(line, match, pattern))
-		return "";
-	string text = match.str(1);
-	size_t pos;
-	while ((pos = text.find("<br>")) != string::npos)
-		text.replace(pos, 4, "\n");
-	return text;
+	const char *s = line.data();
+	const size_t n = line.size();
+	string text;
+	for (size_t open = findTag(s, n, 0, "<p", 2); open < n; open = findTag(s, n, open + 1, "<p", 2))
+	{
+		const size_t begin = open + 2 + Scanner::find(s + open + 2, n - open - 2, '>');
+		if (begin >= n)
+			return "";
+		const size_t close = findTag(s, n, begin + 1, "</p>", 4);
+		if (close == n)
+			continue;
+		const char *from = s + begin + 1;
+		const size_t length = close - begin - 1;
+		if (Scanner::find(from, length, '\n') != length || Scanner::find(from, length, '\r') != length)
+			continue;
+		text.reserve(length);
+		for (size_t i = 0; i < length;)
+		{
+			const size_t br = i + Scanner::find(from + i, length - i, "<br>", 4);
+			text.append(from + i, br - i);
+			if (br == length)
+				break;
+			text += '\n';
+			i = br + 4;
+		}
+		return text;
+	}
+	return "";
 }
 
-void SAMI::fileParse(istream &f)
+void SAMI::bufferParse(const string &buffer)
 {
+	const size_t cues = presize(buffer);
+	Scanner::LineCursor lines(buffer);
 	string line;
 	Structures::Node sub;
 	bool inSubtitle = false;
 	bool inParagraph = false;
 	string paragraphBuffer;
+	string dialogue;
+	paragraphBuffer.reserve(averageText(buffer, cues));
+	dialogue.reserve(averageText(buffer, cues));
 
-	while (getline(f, line))
+	while (lines.next(line))
 	{
 		if (line.find("<SYNC Start=") != string::npos)
 		{
@@ -49,18 +107,19 @@ void SAMI::fileParse(istream &f)
 				if (!paragraphBuffer.empty())
 				{
 					string text = dialogueParse(paragraphBuffer);
-					if (!sub.dialogue.empty())
-						sub.dialogue += '\n';
-					sub.dialogue += text;
+					if (!dialogue.empty())
+						dialogue += '\n';
+					dialogue += text;
 					paragraphBuffer.clear();
 					inParagraph = false;
 				}
-				contents.push_back(sub);
+				sub.dialogue = makeText(dialogue.data(), dialogue.size());
+				contents.push_back(std::move(sub));
 				sub = Structures::Node();
 			}
 			sub.time = timeParse(line);
 			inSubtitle = true;
-			sub.dialogue = "";
+			dialogue.clear();
 		}
 		else if (line.find("<P") != string::npos)
 		{
@@ -71,9 +130,9 @@ void SAMI::fileParse(istream &f)
 				if (line.find("</P>") != string::npos)
 				{
 					string text = dialogueParse(paragraphBuffer);
-					if (!sub.dialogue.empty())
-						sub.dialogue += '\n';
-					sub.dialogue += text;
+					if (!dialogue.empty())
+						dialogue += '\n';
+					dialogue += text;
 					paragraphBuffer.clear();
 					inParagraph = false;
 				}
@@ -85,9 +144,9 @@ void SAMI::fileParse(istream &f)
 			if (line.find("</P>") != string::npos)
 			{
 				string text = dialogueParse(paragraphBuffer);
-				if (!sub.dialogue.empty())
-					sub.dialogue += '\n';
-				sub.dialogue += text;
+				if (!dialogue.empty())
+					dialogue += '\n';
+				dialogue += text;
 				paragraphBuffer.clear();
 				inParagraph = false;
 			}
@@ -98,17 +157,39 @@ void SAMI::fileParse(istream &f)
 		if (!paragraphBuffer.empty())
 		{
 			string text = dialogueParse(paragraphBuffer);
-			if (!sub.dialogue.empty())
-				sub.dialogue += '\n';
-			sub.dialogue += text;
+			if (!dialogue.empty())
+				dialogue += '\n';
+			dialogue += text;
 		}
-		contents.push_back(sub);
+		sub.dialogue = makeText(dialogue.data(), dialogue.size());
+		contents.push_back(std::move(sub));
 	}
 }
 
-DynamicArray< Structures::Node > SAMI::getCollisions()
+size_t SAMI::estimateCues(const string &buffer) const
+{
+	return Scanner::count(buffer.data(), buffer.size(), "<SYNC Start=", 12);
+}
+
+size_t SAMI::completeLength(const string &buffer) const
+{
+	const size_t pos = buffer.rfind("<SYNC Start=");
+	if (pos == string::npos || pos == 0)
+		return 0;
+	const size_t lineStart = buffer.rfind('\n', pos - 1);
+	if (lineStart == string::npos)
+		return 0;
+	return lineStart + 1;
+}
+
+bool SAMI::collides(const Structures::Node &first, const Structures::Node &second) const
+{
+	return first.time.start >= second.time.start;
+}
+
+DynamicArray< Structures::Node > SAMI::getCollisions() const
 {
-	DynamicArray< Structures::Node > collisions;
+	DynamicArray< Structures::Node > collisions(&PoolAllocator::shared());
 	const int n = contents.size();
 
 	for (int i = 0; i < n; ++i)
@@ -118,7 +199,7 @@ DynamicArray< Structures::Node > SAMI::getCollisions()
 			const Structures::Node &first = contents[i];
 			const Structures::Node &second = contents[j];
 
-			if (first.time.start >= second.time.start)
+			if (collides(first, second))
 			{
 				collisions.push_back(first);
 				collisions.push_back(second);
@@ -128,19 +209,36 @@ DynamicArray< Structures::Node > SAMI::getCollisions()
 	return collisions;
 }
 
+// SAMI pairs are ordering conflicts, not time overlaps, so the time buckets of the base version
+// do not apply and the thread count is ignored.
+DynamicArray< Structures::Node > SAMI::getCollisionsParallel(unsigned) const
+{
+	return getCollisions();
+}
+
 void SAMI::setFormat()
 {
+	if (lazyFormat)
+	{
+		transform.wrap("<i>", "</i>");
+		return;
+	}
 	for (auto &k : contents)
 	{
-		k.dialogue = "<i>" + k.dialogue + "</i>";
+		k.dialogue = makeText("<i>" + k.dialogue + "</i>");
 	}
 }
 
 void SAMI::deleteFormat()
 {
-	regex pattern(R"((\{.*?\}|<.*?>))");
+	if (lazyFormat)
+	{
+		transform.strip(TextTransform::BracesAndTags);
+		return;
+	}
+	static const regex pattern(R"((\{.*?\}|<.*?>))");
 	for (auto &k : contents)
 	{
-		k.dialogue = regex_replace(k.dialogue, pattern, "");
+		k.dialogue = makeText(regex_replace(k.dialogue.str(), pattern, ""));
 	}
 }
@@ -1,85 +1,171 @@
 #include "SRT.h"
 
 #include "DynamicArray.h"
+#include "Scanner.h"
 
+#include <algorithm>
 #include <regex>
 #include <string>
 
+using namespace std;
+
 Structures::Time SRT::timeParse(const string &s)
 {
 	Structures::Time t;
-	regex pattern(R"((\d{2}):(\d{2}):(\d{2}),(\d{3}) --> (\d{2}):(\d{2}):(\d{2}),(\d{3}))");
-	smatch match;
-	if (!regex_search(s, match, pattern))
+	size_t pos = 0;
+	while ((pos = Scanner::find(s, " --> ", 5, pos)) != string::npos)
 	{
-		return t;
+		t = Structures::Time::fromArrow(s.data(), s.size(), pos);
+		if (!t.isEmpty())
+			return t;
+		++pos;
 	}
-	string st = match.str(1) + ':' + match.str(2) + ':' + match.str(3) + ',' + match.str(4);
-	string en = match.str(5) + ':' + match.str(6) + ':' + match.str(7) + ',' + match.str(8);
-	t.start = Structures::Time::timeConverter(st);
-	t.end = Structures::Time::timeConverter(en);
 	return t;
 }
 
+namespace
+{
+// Same test as regex_search with [A-Z], without building a regex for every line.
+bool hasCapital(const string &s)
+{
+	return std::any_of(s.begin(), s.end(), [](char c) { return c >= 'A' && c <= 'Z'; });
+}
+}
+
 string SRT::dialogueParse(const string &s)
 {
-	regex pattern("[A-Z]");
-	if (regex_search(s, pattern))
+	if (hasCapital(s))
 	{
 		return s;
 	}
 	return "";
 }
 
-void SRT::fileParse(istream &f)
+void SRT::bufferParse(const string &buffer)
 {
+	const size_t cues = presize(buffer);
+	Scanner::LineCursor lines(buffer);
 	string line;
+	string timeLine;
+	// Reused for every cue; each payload is then copied out at its exact size.
+	string dialogue;
+	dialogue.reserve(averageText(buffer, cues));
 	Structures::Node sub;
-	while (getline(f, line))
+	// Lines come without the CR of a CRLF break.
+	auto next = [&lines](string &into) {
+		if (!lines.next(into))
+			return false;
+		if (!into.empty() && into.back() == '\r')
+			into.pop_back();
+		return true;
+	};
+	while (next(line))
 	{
 		if (line.empty())
 			continue;
 
-		string timeLine;
-		if (!getline(f, timeLine))
+		if (!next(timeLine))
 			break;
 		sub.time = timeParse(timeLine);
-		string dialogue;
-		while (getline(f, line) && !line.empty())
+		dialogue.clear();
+		while (next(line) && !line.empty())
 		{
 			if (!dialogue.empty())
 				dialogue += "\n";
-			dialogue += dialogueParse(line);
+			if (hasCapital(line))
+				dialogue += line;
 		}
-		sub.dialogue = dialogue;
+		sub.dialogue = makeText(dialogue.data(), dialogue.size());
 		if (!sub.time.isEmpty() && !sub.dialogue.empty())
 		{
-			contents.push_back(sub);
+			contents.push_back(std::move(sub));
 			sub = Structures::Node();
 		}
 	}
 }
 
+size_t SRT::estimateCues(const string &buffer) const
+{
+	return Scanner::count(buffer.data(), buffer.size(), " --> ", 5);
+}
+
+size_t SRT::rangeHeader(const char *, size_t) const
+{
+	return 0;
+}
+
+// A cue is found by its timing line and begins at the index line above it.
+bool SRT::cueBoundary(const char *data, size_t size, size_t &pos, Structures::Ticks &start)
+{
+	size_t from = pos;
+	while (from < size)
+	{
+		const size_t arrow = from + Scanner::find(data + from, size - from, " --> ", 5);
+		if (arrow >= size)
+			return false;
+		size_t line = arrow;
+		while (line > 0 && data[line - 1] != '\n')
+			--line;
+		const size_t end = arrow + Scanner::find(data + arrow, size - arrow, '\n');
+		const Structures::Time t = timeParse(string(data + line, end - line));
+		if (!t.isEmpty())
+		{
+			size_t index = line;
+			if (index > 0)
+			{
+				--index;
+				while (index > 0 && data[index - 1] != '\n')
+					--index;
+			}
+			pos = index;
+			start = t.start;
+			return true;
+		}
+		from = arrow + 5;
+	}
+	return false;
+}
+
+size_t SRT::completeLength(const string &buffer) const
+{
+	return pastLastBlankLine(buffer);
+}
+
 void SRT::deleteFormat()
 {
-	regex pattern(R"((\{.*?\}|<.*?>))");
+	if (lazyFormat)
+	{
+		transform.strip(TextTransform::BracesAndTags);
+		return;
+	}
+	static const regex pattern(R"((\{.*?\}|<.*?>))");
 	for (auto &k : contents)
 	{
-		k.dialogue = regex_replace(k.dialogue, pattern, "");
+		k.dialogue = makeText(regex_replace(k.dialogue.str(), pattern, ""));
 	}
 }
 
 void SRT::setFormat()
 {
+	if (lazyFormat)
+	{
+		transform.wrap("<i>", "</i>");
+		return;
+	}
 	for (auto &k : contents)
 	{
-		k.dialogue = "<i>" + k.dialogue + "</i>";
+		k.dialogue = makeText("<i>" + k.dialogue + "</i>");
 	}
 }
 
-DynamicArray< Structures::Node > SRT::getCollisions()
+bool SRT::collides(const Structures::Node &first, const Structures::Node &second) const
+{
+	return first.time.start < second.time.end && second.time.start < first.time.end;
+}
+
+DynamicArray< Structures::Node > SRT::getCollisions() const
 {
-	DynamicArray< Structures::Node > collisions;
+	DynamicArray< Structures::Node > collisions(&PoolAllocator::shared());
 	const int n = contents.size();
 
 	for (int i = 0; i < n; ++i)
@@ -89,7 +175,7 @@ DynamicArray< Structures::Node > SRT::getCollisions()
 			const Structures::Node &first = contents[i];
 			const Structures::Node &second = contents[j];
 
-			if (first.time.start < second.time.end && second.time.start < first.time.end)
+			if (collides(first, second))
 			{
 				collisions.push_back(first);
 				collisions.push_back(second);
@@ -1,57 +1,214 @@
 #include "SSA.h"
 
 #include "DynamicArray.h"
+#include "Scanner.h"
 
+#include <cctype>
+#include <cstring>
 #include <regex>
 #include <string>
 
+using namespace std;
+
 Structures::Time SSA::timeParse(const string &s)
 {
   Structures::Time time;
-  regex pattern(R"(Dialogue:\s*(\d+),(\d+):(\d{2}):(\d{2})\.(\d{2}),(\d+):(\d{2}):(\d{2})\.(\d{2}))");
-  smatch match;
-  if (!regex_search(s, match, pattern))
+  size_t pos = Scanner::find(s, "Dialogue:", 9);
+  if (pos == string::npos)
+  {
+    return time;
+  }
+  pos += 9;
+  while (pos < s.size() && isspace((unsigned char)s[pos]))
+    ++pos;
+
+  int layer = 0;
+  const size_t layerStart = pos;
+  while (pos < s.size() && isdigit((unsigned char)s[pos]))
+    layer = layer * 10 + (s[pos++] - '0');
+  if (pos == layerStart || pos >= s.size() || s[pos] != ',')
+  {
+    return time;
+  }
+
+  const size_t beginStart = pos + 1;
+  const size_t beginEnd = s.find(',', beginStart);
+  if (beginEnd == string::npos)
   {
     return time;
   }
-  time.layer = stoi(match.str(1));
-  string begin = match.str(2) + ":" + match.str(3) + ":" + match.str(4) + "." + match.str(5);
-  string finish = match.str(6) + ":" + match.str(7) + ":" + match.str(8) + "." + match.str(9);
-  time.start = Structures::Time::timeConverter(begin);
-  time.end = Structures::Time::timeConverter(finish);
-  return time;
+  size_t finishEnd = s.find(',', beginEnd + 1);
+  if (finishEnd == string::npos)
+    finishEnd = s.size();
+  return Structures::Time::fromClocks(s.data() + beginStart, beginEnd - beginStart, s.data() + beginEnd + 1,
+                                      finishEnd - beginEnd - 1, layer);
 }
 
-string SSA::dialogueParse(const string &s)
+// Same as regex_search with ^Dialogue:\s*(?:[^,]*,){9}(.*)$: the offset of the Text field after
+// the ninth comma, or npos when there is none or a line break follows it.
+size_t SSA::textField(const char *line, size_t length)
 {
-  regex pattern(R"(^Dialogue:\s*(?:[^,]*,){9}(.*)$)");
-  smatch match;
-  if (!regex_search(s, match, pattern))
+  if (length < 9 || memcmp(line, "Dialogue:", 9) != 0)
+    return string::npos;
+  size_t pos = 9;
+  for (int field = 0; field < 9; ++field)
   {
-    return " ";
+    pos += Scanner::find(line + pos, length - pos, ',');
+    if (pos == length)
+      return string::npos;
+    ++pos;
   }
-  return match.str(1);
+  if (Scanner::find(line + pos, length - pos, '\r') != length - pos ||
+      Scanner::find(line + pos, length - pos, '\n') != length - pos)
+    return string::npos;
+  return pos;
+}
+
+string SSA::dialogueParse(const string &s)
+{
+  const size_t text = textField(s.data(), s.size());
+  return text == string::npos ? " " : s.substr(text);
 }
 
-void SSA::fileParse(istream &f)
+void SSA::bufferParse(const string &buffer)
 {
+  presize(buffer);
+  Scanner::LineCursor lines(buffer);
   string line;
   Structures::Node sub;
-  while (getline(f, line))
+  while (lines.next(line))
   {
-    if (line.find("Dialogue") != string::npos)
+    if (!line.empty() && line[0] == '[')
+    {
+      inStyles = line.compare(0, 12, "[V4+ Styles]") == 0 || line.compare(0, 11, "[V4 Styles]") == 0;
+      inScriptInfo = line.compare(0, 13, "[Script Info]") == 0;
+      continue;
+    }
+    if (inScriptInfo)
+    {
+      if (!line.empty())
+        styles.scriptInfo.push_back(line);
+      continue;
+    }
+    if (inStyles)
+    {
+      if (line.compare(0, 7, "Format:") == 0)
+        styles.format = line;
+      else if (line.compare(0, 6, "Style:") == 0)
+        styleParse(line);
+      continue;
+    }
+    if (Scanner::find(line, "Dialogue", 8) != string::npos)
     {
       sub.time = timeParse(line);
-      sub.dialogue = dialogueParse(line);
-      contents.push_back(sub);
+      // The payload is copied straight from the line into the arena.
+      const size_t text = textField(line.data(), line.size());
+      sub.dialogue = text == string::npos ? makeText(" ", 1) : makeText(line.data() + text, line.size() - text);
+      namesParse(line, sub);
+      contents.push_back(std::move(sub));
       sub = Structures::Node();
     }
   }
 }
 
-DynamicArray< Structures::Node > SSA::getCollisions()
+void SSA::styleParse(const string &s)
+{
+  size_t begin = 6;
+  while (begin < s.size() && s[begin] == ' ')
+    ++begin;
+  size_t end = s.find(',', begin);
+  if (end == string::npos)
+    end = s.size();
+  const int id = styles.addStyle(s.data() + begin, end - begin);
+  styles.definitions[id] = s;
+}
+
+void SSA::namesParse(const string &s, Structures::Node &node)
+{
+  size_t comma[9];
+  size_t pos = s.find("Dialogue:");
+  if (pos == string::npos)
+    return;
+  int found = 0;
+  for (; found < 9; ++found)
+  {
+    pos = s.find(',', pos + 1);
+    if (pos == string::npos)
+      break;
+    comma[found] = pos;
+  }
+  if (found < 5)
+    return;
+  node.style = styles.addStyle(s.data() + comma[2] + 1, comma[3] - comma[2] - 1);
+  node.actor = styles.actors.intern(s.data() + comma[3] + 1, comma[4] - comma[3] - 1);
+  if (found == 9)
+    node.layout = styles.layouts.intern(s.data() + comma[4] + 1, comma[8] - comma[4] - 1);
+}
+
+size_t SSA::estimateCues(const string &buffer) const
+{
+  return Scanner::count(buffer.data(), buffer.size(), "Dialogue:", 9);
+}
+
+size_t SSA::completeLength(const string &buffer) const
+{
+  const size_t pos = buffer.rfind('\n');
+  if (pos == string::npos)
+    return 0;
+  return pos + 1;
+}
+
+// Style sections are only recognised after their header, so everything before [Events] stays together.
+size_t SSA::headerLength(const string &buffer) const
+{
+  const size_t pos = buffer.find("\n[Events]");
+  return pos == string::npos ? 0 : pos + 1;
+}
+
+// Script info and styles up to and including the [Events] line, so a window of events parses as events.
+size_t SSA::rangeHeader(const char *data, size_t size) const
+{
+  size_t events = Scanner::find(data, size, "[Events]", 8);
+  while (events < size && events > 0 && data[events - 1] != '\n')
+    events += 1 + Scanner::find(data + events + 1, size - events - 1, "[Events]", 8);
+  if (events >= size)
+    return 0;
+  const size_t end = events + Scanner::find(data + events, size - events, '\n');
+  return end < size ? end + 1 : size;
+}
+
+bool SSA::cueBoundary(const char *data, size_t size, size_t &pos, Structures::Ticks &start)
+{
+  size_t from = pos;
+  while (from < size)
+  {
+    const size_t at = from + Scanner::find(data + from, size - from, "Dialogue:", 9);
+    if (at >= size)
+      return false;
+    from = at + 9;
+    if (at > 0 && data[at - 1] != '\n')
+      continue;
+    const size_t end = at + Scanner::find(data + at, size - at, '\n');
+    const Structures::Time t = timeParse(string(data + at, end - at));
+    if (!t.isEmpty())
+    {
+      pos = at;
+      start = t.start;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SSA::collides(const Structures::Node &first, const Structures::Node &second) const
 {
-  DynamicArray< Structures::Node > collisions;
+  return first.time.layer == second.time.layer && first.time.start < second.time.end &&
+         second.time.start < first.time.end;
+}
+
+DynamicArray< Structures::Node > SSA::getCollisions() const
+{
+  DynamicArray< Structures::Node > collisions(&PoolAllocator::shared());
   const int n = contents.size();
 
   for (int i = 0; i < n; ++i)
@@ -61,8 +218,7 @@ DynamicArray< Structures::Node > SSA::getCollisions()
       const Structures::Node &first = contents[i];
       const Structures::Node &second = contents[j];
 
-      if (first.time.layer == second.time.layer && first.time.start < second.time.end &&
-              second.time.start < first.time.end)
+      if (collides(first, second))
       {
         collisions.push_back(first);
         collisions.push_back(second);
@@ -74,17 +230,27 @@ DynamicArray< Structures::Node > SSA::getCollisions()
 
 void SSA::setFormat()
 {
+  if (lazyFormat)
+  {
+    transform.wrap("{\\b1}", "{\\b0}");
+    return;
+  }
   for (auto &k : contents)
   {
-    k.dialogue = "{\\b1}" + k.dialogue + "{\\b0}";
+    k.dialogue = makeText("{\\b1}" + k.dialogue + "{\\b0}");
   }
 }
 
 void SSA::deleteFormat()
 {
-  regex pattern(R"((\{.*?\}|<.*?>))");
+  if (lazyFormat)
+  {
+    transform.strip(TextTransform::BracesAndTags);
+    return;
+  }
+  static const regex pattern(R"((\{.*?\}|<.*?>))");
   for (auto &k : contents)
   {
-    k.dialogue = regex_replace(k.dialogue, pattern, "");
+    k.dialogue = makeText(regex_replace(k.dialogue.str(), pattern, ""));
   }
 }
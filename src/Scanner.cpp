@@ -0,0 +1,250 @@
+#include "Scanner.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCANNER_SSE2
+#endif
+
+// SCANNER_NO_AVX2 keeps the SSE2 kernel on AVX2 machines, e.g. to benchmark it.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(SCANNER_NO_AVX2)
+#include <immintrin.h>
+#define SCANNER_AVX2
+#endif
+
+namespace
+{
+inline int lowestBit(uint64_t m)
+{
+#if defined(__GNUC__)
+  return __builtin_ctzll(m);
+#else
+  int i = 0;
+  while (!(m & 1))
+  {
+    m >>= 1;
+    ++i;
+  }
+  return i;
+#endif
+}
+
+inline int bitCount(uint64_t m)
+{
+#if defined(__GNUC__)
+  return __builtin_popcountll(m);
+#else
+  int n = 0;
+  for (; m; m &= m - 1)
+    ++n;
+  return n;
+#endif
+}
+
+#ifndef SCANNER_SSE2
+uint64_t maskScalar(const char* p, char c)
+{
+  uint64_t m = 0;
+  for (int i = 0; i < 64; ++i)
+  {
+    if (p[i] == c)
+      m |= uint64_t(1) << i;
+  }
+  return m;
+}
+#endif
+
+#ifdef SCANNER_SSE2
+uint64_t maskSSE2(const char* p, char c)
+{
+  const __m128i needle = _mm_set1_epi8(c);
+  uint64_t m = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast< const __m128i* >(p + 16 * i));
+    m |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)))) << (16 * i);
+  }
+  return m;
+}
+#endif
+
+#ifdef SCANNER_AVX2
+__attribute__((target("avx2"))) uint64_t maskAVX2(const char* p, char c)
+{
+  const __m256i needle = _mm256_set1_epi8(c);
+  const __m256i lo = _mm256_loadu_si256(reinterpret_cast< const __m256i* >(p));
+  const __m256i hi = _mm256_loadu_si256(reinterpret_cast< const __m256i* >(p + 32));
+  const uint32_t mlo = _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle));
+  const uint32_t mhi = _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle));
+  return uint64_t(mlo) | (uint64_t(mhi) << 32);
+}
+#endif
+
+struct Dispatch
+{
+  uint64_t (*mask)(const char*, char);
+  const char* name;
+};
+
+Dispatch select()
+{
+#ifdef SCANNER_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return { maskAVX2, "avx2" };
+#endif
+#ifdef SCANNER_SSE2
+  return { maskSSE2, "sse2" };
+#else
+  return { maskScalar, "scalar" };
+#endif
+}
+
+const Dispatch& dispatch()
+{
+  static const Dispatch d = select();
+  return d;
+}
+}
+
+namespace Scanner
+{
+uint64_t mask(const char* p, char c) { return dispatch().mask(p, c); }
+
+const char* implementation() { return dispatch().name; }
+
+size_t find(const char* data, size_t size, char c)
+{
+  const auto m = dispatch().mask;
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64)
+  {
+    const uint64_t bits = m(data + i, c);
+    if (bits)
+      return i + lowestBit(bits);
+  }
+  const void* hit = memchr(data + i, c, size - i);
+  return hit ? static_cast< const char* >(hit) - data : size;
+}
+
+size_t find(const char* data, size_t size, const char* needle, size_t length)
+{
+  if (length == 0)
+    return 0;
+  if (length == 1)
+    return find(data, size, needle[0]);
+  if (length > size)
+    return size;
+
+  const auto m = dispatch().mask;
+  size_t i = 0;
+  for (; i + 64 + length - 1 <= size; i += 64)
+  {
+    uint64_t bits = m(data + i, needle[0]) & m(data + i + length - 1, needle[length - 1]);
+    while (bits)
+    {
+      const size_t at = i + lowestBit(bits);
+      if (memcmp(data + at + 1, needle + 1, length - 2) == 0)
+        return at;
+      bits &= bits - 1;
+    }
+  }
+  for (; i + length <= size; ++i)
+  {
+    if (data[i] == needle[0] && memcmp(data + i + 1, needle + 1, length - 1) == 0)
+      return i;
+  }
+  return size;
+}
+
+size_t count(const char* data, size_t size, char c)
+{
+  const auto m = dispatch().mask;
+  size_t n = 0;
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64)
+    n += bitCount(m(data + i, c));
+  for (; i < size; ++i)
+    n += data[i] == c;
+  return n;
+}
+
+size_t count(const char* data, size_t size, const char* needle, size_t length)
+{
+  size_t n = 0;
+  size_t pos = 0;
+  while ((pos += find(data + pos, size - pos, needle, length)) < size)
+  {
+    ++n;
+    pos += length;
+  }
+  return n;
+}
+
+void findAll(const char* data, size_t size, char c, DynamicArray< size_t >& out)
+{
+  const auto m = dispatch().mask;
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64)
+  {
+    for (uint64_t bits = m(data + i, c); bits; bits &= bits - 1)
+      out.push_back(i + lowestBit(bits));
+  }
+  for (; i < size; ++i)
+  {
+    if (data[i] == c)
+      out.push_back(i);
+  }
+}
+
+size_t LineCursor::nextNewline()
+{
+  if (pos < block || pos >= block + 64)
+  {
+    block = pos;
+    loaded = false;
+  }
+  while (true)
+  {
+    if (!loaded)
+    {
+      if (block + 64 > size)
+      {
+        const size_t from = pos > block ? pos : block;
+        return from + find(data + from, size - from, '\n');
+      }
+      bits = mask(data + block, '\n');
+      loaded = true;
+    }
+    uint64_t m = bits;
+    if (pos > block)
+      m &= ~uint64_t(0) << (pos - block);
+    if (m)
+      return block + lowestBit(m);
+    block += 64;
+    loaded = false;
+  }
+}
+
+bool LineCursor::next(const char*& line, size_t& length)
+{
+  if (pos >= size)
+    return false;
+  const size_t end = nextNewline();
+  line = data + pos;
+  length = end - pos;
+  pos = end < size ? end + 1 : size;
+  return true;
+}
+
+bool LineCursor::next(std::string& line)
+{
+  const char* p;
+  size_t n;
+  if (!next(p, n))
+    return false;
+  line.assign(p, n);
+  return true;
+}
+}
@@ -0,0 +1,141 @@
+#include "Scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+thread_local const WorkStealingScheduler* currentScheduler = nullptr;
+thread_local unsigned currentWorker = 0;
+}
+
+WorkStealingScheduler::WorkStealingScheduler(unsigned threadCount, bool steal)
+  : stealing(steal), queued(0), pending(0), nextWorker(0)
+{
+  if (threadCount == 0)
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 0; i < threadCount; ++i)
+    workers.emplace_back(new Worker());
+  for (unsigned i = 0; i < threadCount; ++i)
+    threads.emplace_back(&WorkStealingScheduler::run, this, i);
+}
+
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+  wait();
+  {
+    std::lock_guard< std::mutex > guard(sleepLock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& t : threads)
+    t.join();
+}
+
+void WorkStealingScheduler::submit(std::function< void() > task)
+{
+  const unsigned target = currentScheduler == this ? currentWorker : nextWorker++ % size();
+  ++pending;
+  {
+    std::lock_guard< std::mutex > guard(workers[target]->lock);
+    workers[target]->tasks.push_back(std::move(task));
+  }
+  ++queued;
+  {
+    std::lock_guard< std::mutex > guard(sleepLock);
+  }
+  if (stealing)
+    wake.notify_one();
+  else
+    wake.notify_all();
+}
+
+bool WorkStealingScheduler::popLocal(unsigned self, std::function< void() >& task)
+{
+  Worker& w = *workers[self];
+  std::lock_guard< std::mutex > guard(w.lock);
+  if (w.tasks.empty())
+    return false;
+  task = std::move(w.tasks.back());
+  w.tasks.pop_back();
+  return true;
+}
+
+bool WorkStealingScheduler::steal(unsigned self, std::function< void() >& task)
+{
+  for (unsigned k = 1; k < size(); ++k)
+  {
+    Worker& victim = *workers[(self + k) % size()];
+    std::lock_guard< std::mutex > guard(victim.lock);
+    if (victim.tasks.empty())
+      continue;
+    task = std::move(victim.tasks.front());
+    victim.tasks.pop_front();
+    ++workers[self]->stats.steals;
+    return true;
+  }
+  return false;
+}
+
+void WorkStealingScheduler::run(unsigned self)
+{
+  currentScheduler = this;
+  currentWorker = self;
+  Worker& w = *workers[self];
+  for (;;)
+  {
+    std::function< void() > task;
+    if (popLocal(self, task) || (stealing && steal(self, task)))
+    {
+      --queued;
+      const auto begin = std::chrono::steady_clock::now();
+      task();
+      task = nullptr;
+      w.stats.busySeconds += std::chrono::duration< double >(std::chrono::steady_clock::now() - begin).count();
+      ++w.stats.tasks;
+      if (--pending == 0)
+      {
+        std::lock_guard< std::mutex > guard(sleepLock);
+        idle.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock< std::mutex > guard(sleepLock);
+    if (stopping)
+      return;
+    if (stealing)
+    {
+      wake.wait(guard, [this]() { return stopping || queued > 0; });
+    }
+    else
+    {
+      // Work may sit on other deques that this worker must not touch.
+      std::unique_lock< std::mutex > own(w.lock);
+      const bool empty = w.tasks.empty();
+      own.unlock();
+      if (empty)
+        wake.wait(guard);
+    }
+  }
+}
+
+void WorkStealingScheduler::wait()
+{
+  std::unique_lock< std::mutex > guard(sleepLock);
+  idle.wait(guard, [this]() { return pending == 0; });
+}
+
+std::vector< WorkStealingScheduler::WorkerStats > WorkStealingScheduler::getStats() const
+{
+  std::vector< WorkerStats > stats;
+  for (const auto& w : workers)
+    stats.push_back(w->stats);
+  return stats;
+}
+
+void WorkStealingScheduler::resetStats()
+{
+  for (auto& w : workers)
+    w->stats = WorkerStats();
+}
@@ -0,0 +1,99 @@
+#include "Segmenter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+// A zero-length cue still belongs to the segment it starts in.
+Structures::Ticks effectiveEnd(const Structures::Node& node)
+{
+  return std::max(node.time.end, node.time.start + 1);
+}
+}
+
+Segmenter::Segmenter(const WriteBehavior& w, Structures::Ticks d, Sink s, const Structures::StyleSheet& sheet)
+  : writer(w), duration(d), sink(std::move(s)), styles(sheet)
+{
+  if (duration <= 0)
+    throw std::invalid_argument("Segment duration must be positive");
+}
+
+void Segmenter::close()
+{
+  const Structures::Ticks end = segmentStart() + duration;
+  segment.clear();
+  for (const auto& node : active)
+  {
+    if (node.time.start < end)
+      segment.push_back(node);
+  }
+  sink(index, segmentStart(), writer.writeToString(segment, styles));
+
+  ++index;
+  const Structures::Ticks next = segmentStart();
+  active.erase(std::remove_if(active.begin(), active.end(),
+                              [next](const Structures::Node& node) { return effectiveEnd(node) <= next; }),
+               active.end());
+}
+
+void Segmenter::push(const Structures::Node& node)
+{
+  if (node.time.start < lastStart || node.time.start < 0)
+    throw std::invalid_argument("Cues must be pushed in start order");
+  lastStart = node.time.start;
+  while (node.time.start >= segmentStart() + duration)
+    close();
+  active.push_back(node);
+}
+
+void Segmenter::push(const DynamicArray< Structures::Node >& nodes)
+{
+  for (const auto& node : nodes)
+    push(node);
+}
+
+size_t Segmenter::finish()
+{
+  while (!active.empty())
+    close();
+  return index;
+}
+
+namespace HLS
+{
+size_t writeSegments(const DynamicArray< Structures::Node >& nodes, const WriteBehavior& writer,
+                     Structures::Ticks duration, const std::string& prefix, const std::string& extension,
+                     const Structures::StyleSheet& styles)
+{
+  std::vector< std::string > names;
+  bool failed = false;
+  Segmenter segmenter(writer, duration,
+                      [&](size_t index, Structures::Ticks, const std::string& document) {
+                        char number[16];
+                        std::snprintf(number, sizeof(number), "%05zu", index);
+                        const std::string name = prefix + number + extension;
+                        std::ofstream out(name, std::ios::binary);
+                        failed |= !out.write(document.data(), document.size());
+                        names.push_back(name.substr(name.find_last_of("/\\") + 1));
+                      },
+                      styles);
+  segmenter.push(nodes);
+  const size_t count = segmenter.finish();
+
+  std::ofstream playlist(prefix + ".m3u8");
+  char seconds[32];
+  std::snprintf(seconds, sizeof(seconds), "%.3f", duration / 1000.0);
+  playlist << "#EXTM3U\n#EXT-X-VERSION:3\n";
+  playlist << "#EXT-X-TARGETDURATION:" << (duration + 999) / 1000 << "\n";
+  playlist << "#EXT-X-MEDIA-SEQUENCE:0\n#EXT-X-PLAYLIST-TYPE:VOD\n";
+  for (const auto& name : names)
+    playlist << "#EXTINF:" << seconds << ",\n" << name << "\n";
+  playlist << "#EXT-X-ENDLIST\n";
+  if (failed || !playlist)
+    throw std::runtime_error("Failed to write segments for " + prefix);
+  return count;
+}
+}
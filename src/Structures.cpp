@@ -0,0 +1,142 @@
+#include "Structures.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define STRUCTURES_SSE2
+#endif
+
+namespace
+{
+// Converts a canonical "HH:MM:SS?mmm" clock (? is '.' or ',') to milliseconds.
+#ifdef STRUCTURES_SSE2
+bool canonicalClock(const char* clock, int& milliseconds)
+{
+  char raw[16] = {};
+  memcpy(raw, clock, 12);
+  const __m128i bytes = _mm_loadu_si128(reinterpret_cast< const __m128i* >(raw));
+  const __m128i digits = _mm_sub_epi8(bytes, _mm_set1_epi8('0'));
+
+  const __m128i outOfRange = _mm_or_si128(_mm_cmpgt_epi8(digits, _mm_set1_epi8(9)),
+                                          _mm_cmplt_epi8(digits, _mm_setzero_si128()));
+  const int digitPositions = 0x0EDB;
+  if (_mm_movemask_epi8(outOfRange) & digitPositions)
+    return false;
+
+  const __m128i comma = _mm_setr_epi8(0, 0, ':', 0, 0, ':', 0, 0, ',', 0, 0, 0, 0, 0, 0, 0);
+  const __m128i dot = _mm_setr_epi8(0, 0, ':', 0, 0, ':', 0, 0, '.', 0, 0, 0, 0, 0, 0, 0);
+  const int separators = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, comma), _mm_cmpeq_epi8(bytes, dot)));
+  if ((separators & 0x0124) != 0x0124)
+    return false;
+
+  // Widen to 16-bit lanes; separator lanes get weight 0.
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i lo = _mm_unpacklo_epi8(digits, zero);
+  const __m128i hi = _mm_unpackhi_epi8(digits, zero);
+  // [H, 10*M1, M2, S] and [100*f1, 10*f2 + f3, 0, 0]
+  const __m128i fieldsLo = _mm_madd_epi16(lo, _mm_setr_epi16(10, 1, 0, 10, 1, 0, 10, 1));
+  const __m128i fieldsHi = _mm_madd_epi16(hi, _mm_setr_epi16(0, 100, 10, 1, 0, 0, 0, 0));
+  // [60*H + 10*M1, 60*M2 + S, fraction, 0]
+  const __m128i packed = _mm_packs_epi32(fieldsLo, fieldsHi);
+  const __m128i sums = _mm_madd_epi16(packed, _mm_setr_epi16(60, 1, 60, 1, 1, 1, 0, 0));
+
+  const int minutes = _mm_cvtsi128_si32(sums);
+  const int seconds = _mm_cvtsi128_si32(_mm_srli_si128(sums, 4));
+  const int fraction = _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+  milliseconds = (minutes * 60 + seconds) * 1000 + fraction;
+  return true;
+}
+#else
+bool canonicalClock(const char* clock, int& milliseconds)
+{
+  static const int digitAt[] = { 0, 1, 3, 4, 6, 7, 9, 10, 11 };
+  int d[9];
+  for (int i = 0; i < 9; ++i)
+  {
+    d[i] = clock[digitAt[i]] - '0';
+    if (d[i] < 0 || d[i] > 9)
+      return false;
+  }
+  if (clock[2] != ':' || clock[5] != ':' || (clock[8] != '.' && clock[8] != ','))
+    return false;
+  const int hours = d[0] * 10 + d[1];
+  const int minutes = d[2] * 10 + d[3];
+  const int seconds = d[4] * 10 + d[5];
+  milliseconds = ((hours * 60 + minutes) * 60 + seconds) * 1000 + d[6] * 100 + d[7] * 10 + d[8];
+  return true;
+}
+#endif
+}
+
+namespace Structures
+{
+bool Time::clockParse(const char* p, size_t n, Ticks& milliseconds)
+{
+  if (n == 12 && p[2] == ':')
+  {
+    int canonical = 0;
+    if (!canonicalClock(p, canonical))
+      return false;
+    milliseconds = canonical;
+    return true;
+  }
+
+  size_t colon = 0;
+  while (colon < n && p[colon] != ':')
+    ++colon;
+  if (colon == 0 || colon == n || n < colon + 8 || n > colon + 10)
+    return false;
+
+  // Rebuild the clock in canonical layout: two hour digits, three fraction digits.
+  char clock[12];
+  Ticks hours = 0;
+  if (colon <= 2)
+  {
+    clock[0] = colon == 2 ? p[0] : '0';
+    clock[1] = p[colon - 1];
+  }
+  else
+  {
+    for (size_t i = 0; i < colon; ++i)
+    {
+      if (p[i] < '0' || p[i] > '9')
+        return false;
+      hours = hours * 10 + (p[i] - '0');
+    }
+    clock[0] = clock[1] = '0';
+  }
+  memcpy(clock + 2, p + colon, 7);
+  const size_t fractionDigits = n - colon - 7;
+  for (size_t i = 0; i < 3; ++i)
+    clock[9 + i] = i < fractionDigits ? p[colon + 7 + i] : '0';
+
+  int canonical = 0;
+  if (!canonicalClock(clock, canonical))
+    return false;
+  milliseconds = hours * 3600000 + canonical;
+  return true;
+}
+
+Time Time::fromClocks(const char* begin, size_t beginLength, const char* end, size_t endLength, int layer)
+{
+  Time t;
+  Ticks start = 0;
+  Ticks finish = 0;
+  if (!clockParse(begin, beginLength, start) || !clockParse(end, endLength, finish))
+    return t;
+  return Time(layer, start, finish);
+}
+
+Time Time::fromArrow(const char* line, size_t length, size_t arrow)
+{
+  size_t beginStart = arrow;
+  while (beginStart > 0 && line[beginStart - 1] != ' ' && line[beginStart - 1] != '\t')
+    --beginStart;
+  const size_t endStart = arrow + 5;
+  size_t endEnd = endStart;
+  while (endEnd < length && line[endEnd] != ' ' && line[endEnd] != '\t' && line[endEnd] != '\r')
+    ++endEnd;
+  return fromClocks(line + beginStart, arrow - beginStart, line + endStart, endEnd - endStart);
+}
+}
@@ -0,0 +1,346 @@
+#include "Subtitle.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <queue>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+// One stable LSD pass per byte of the key; bytes that are equal for every cue are skipped.
+template< typename Key >
+void radixSortBy(vector< int >& order, vector< int >& buffer, Key key)
+{
+  typedef typename make_unsigned< decltype(key(0)) >::type Bits;
+  const int digits = sizeof(Bits);
+  const Bits flip = Bits(1) << (sizeof(Bits) * 8 - 1);
+  const int n = order.size();
+
+  vector< int > counts(digits * 256, 0);
+  for (int i = 0; i < n; ++i)
+  {
+    const Bits b = Bits(key(i)) ^ flip;
+    for (int d = 0; d < digits; ++d)
+      ++counts[d * 256 + ((b >> (8 * d)) & 0xFF)];
+  }
+
+  for (int d = 0; d < digits; ++d)
+  {
+    int* count = &counts[d * 256];
+    if (count[(Bits(key(order[0])) ^ flip) >> (8 * d) & 0xFF] == n)
+      continue;
+    int offset = 0;
+    for (int c = 0; c < 256; ++c)
+    {
+      const int k = count[c];
+      count[c] = offset;
+      offset += k;
+    }
+    for (int i = 0; i < n; ++i)
+    {
+      const int idx = order[i];
+      buffer[count[(Bits(key(idx)) ^ flip) >> (8 * d) & 0xFF]++] = idx;
+    }
+    order.swap(buffer);
+  }
+}
+}
+
+DynamicArray< Structures::Node > Subtitle::getCollisionsParallel(unsigned threads) const
+{
+  const int n = contents.size();
+  if (threads <= 1 || n < 2)
+    return getCollisions();
+
+  Structures::Ticks lo = contents[0].time.start;
+  Structures::Ticks hi = lo;
+  for (const auto& node : contents)
+  {
+    lo = min(lo, node.time.start);
+    hi = max(hi, max(node.time.start, node.time.end - 1));
+  }
+
+  const int bucketCount = (int)threads * 4;
+  const Structures::Ticks width = (hi - lo) / bucketCount + 1;
+  auto bucketOf = [&](Structures::Ticks t) { return (int)((t - lo) / width); };
+
+  vector< vector< int > > buckets(bucketCount);
+  for (int i = 0; i < n; ++i)
+  {
+    const Structures::Time& t = contents[i].time;
+    const int last = bucketOf(max(t.start, t.end - 1));
+    for (int b = bucketOf(t.start); b <= last; ++b)
+      buckets[b].push_back(i);
+  }
+
+  // A pair is reported only by the bucket holding the later of the two starts,
+  // so cues straddling bucket edges are never counted twice.
+  vector< vector< pair< int, int > > > found(bucketCount);
+  atomic< int > next(0);
+  auto worker = [&]() {
+    for (int b = next++; b < bucketCount; b = next++)
+    {
+      vector< int >& ids = buckets[b];
+      sort(ids.begin(), ids.end(), [&](int x, int y) {
+        return contents[x].time.start < contents[y].time.start ||
+               (contents[x].time.start == contents[y].time.start && x < y);
+      });
+      for (size_t p = 0; p < ids.size(); ++p)
+      {
+        const Structures::Node& first = contents[ids[p]];
+        for (size_t q = p + 1; q < ids.size() && contents[ids[q]].time.start < first.time.end; ++q)
+        {
+          if (bucketOf(contents[ids[q]].time.start) != b)
+            continue;
+          const int i = min(ids[p], ids[q]);
+          const int j = max(ids[p], ids[q]);
+          if (collides(contents[i], contents[j]))
+            found[b].push_back(make_pair(i, j));
+        }
+      }
+    }
+  };
+
+  vector< thread > pool;
+  for (unsigned t = 1; t < threads; ++t)
+    pool.emplace_back(worker);
+  worker();
+  for (auto& t : pool)
+    t.join();
+
+  vector< pair< int, int > > pairs;
+  for (const auto& part : found)
+    pairs.insert(pairs.end(), part.begin(), part.end());
+  sort(pairs.begin(), pairs.end());
+
+  DynamicArray< Structures::Node > collisions(&PoolAllocator::shared());
+  for (const auto& p : pairs)
+  {
+    collisions.push_back(contents[p.first]);
+    collisions.push_back(contents[p.second]);
+  }
+  return collisions;
+}
+
+DynamicArray< string > Subtitle::split(const string& text, size_t chunkSize) const
+{
+  DynamicArray< string > chunks;
+  size_t from = 0;
+  size_t window = max< size_t >(max(chunkSize, headerLength(text)), 1);
+  while (from < text.size())
+  {
+    size_t length = text.size() - from;
+    // A window without a cue boundary is widened until it holds one.
+    while (window < text.size() - from)
+    {
+      const size_t n = completeLength(text.substr(from, window));
+      if (n > 0)
+      {
+        length = n;
+        break;
+      }
+      window *= 2;
+    }
+    chunks.push_back(text.substr(from, length));
+    from += length;
+    window = max< size_t >(chunkSize, 1);
+  }
+  return chunks;
+}
+
+size_t Subtitle::firstCueFrom(const char* data, size_t size, size_t from, Structures::Ticks target)
+{
+  // The cue found from an offset moves forward with the offset and start times ascend, so the
+  // smallest offset whose cue starts at or after target is found by bisection.
+  size_t lo = from, hi = size;
+  while (lo < hi)
+  {
+    const size_t mid = lo + (hi - lo) / 2;
+    size_t pos = mid;
+    Structures::Ticks start = 0;
+    if (!cueBoundary(data, size, pos, start) || start >= target)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  size_t pos = lo;
+  Structures::Ticks start = 0;
+  return cueBoundary(data, size, pos, start) ? max(pos, from) : size;
+}
+
+bool Subtitle::rangeParse(const char* data, size_t size, Structures::Ticks from, Structures::Ticks to,
+                          Structures::Ticks longestCue)
+{
+  const int before = contents.size();
+  const size_t header = rangeHeader(data, size);
+  const bool seekable = header != string::npos;
+  if (!seekable)
+  {
+    istringstream whole(string(data, size));
+    fileParse(whole);
+  }
+  else
+  {
+    if (header > 0)
+    {
+      istringstream head(string(data, header));
+      fileParse(head);
+    }
+    const size_t begin = firstCueFrom(data, size, header, from - longestCue);
+    const size_t end = firstCueFrom(data, size, begin, to);
+    istringstream window(string(data + begin, end - begin));
+    fileParse(window);
+  }
+
+  int kept = before;
+  for (int i = before; i < contents.size(); ++i)
+  {
+    const Structures::Time& t = contents[i].time;
+    if (t.start < to && max(t.end, t.start + 1) > from)
+    {
+      if (kept != i)
+        contents[kept] = std::move(contents[i]);
+      ++kept;
+    }
+  }
+  while (contents.size() > kept)
+    contents.pop_back();
+  return seekable;
+}
+
+void Subtitle::merge(const DynamicArray< const Subtitle* >& sources)
+{
+  // The destination's own cues take part as the first input, once even when it is also listed
+  // in sources; everything is merged into a fresh array, so no input is read while it grows.
+  DynamicArray< const Subtitle* > inputs;
+  inputs.push_back(this);
+  int total = contents.size();
+  for (const Subtitle* source : sources)
+  {
+    if (source != this)
+    {
+      inputs.push_back(source);
+      total += source->contents.size();
+    }
+  }
+
+  // (start, input, position, end of the ascending run it belongs to)
+  typedef tuple< Structures::Ticks, int, int, int > Cursor;
+  priority_queue< Cursor, vector< Cursor >, greater< Cursor > > heap;
+
+  // Style, actor and layout ids are re-interned into this sheet.
+  vector< vector< int > > styleIds(inputs.size());
+  vector< vector< int > > actorIds(inputs.size());
+  vector< vector< int > > layoutIds(inputs.size());
+  for (int s = 0; s < inputs.size(); ++s)
+  {
+    const Structures::StyleSheet& sheet = inputs[s]->styles;
+    if (s > 0 && styles.format.empty())
+      styles.format = sheet.format;
+    if (s > 0 && styles.scriptInfo.size() == 0)
+      styles.scriptInfo = sheet.scriptInfo;
+    for (int id = 0; id < sheet.styles.size(); ++id)
+    {
+      const string& name = sheet.styles.name(id);
+      const int mapped = styles.addStyle(name.data(), name.size());
+      if (styles.definitions[mapped].empty())
+        styles.definitions[mapped] = sheet.definitions[id];
+      styleIds[s].push_back(mapped);
+    }
+    for (int id = 0; id < sheet.actors.size(); ++id)
+      actorIds[s].push_back(styles.actors.intern(sheet.actors.name(id)));
+    for (int id = 0; id < sheet.layouts.size(); ++id)
+      layoutIds[s].push_back(styles.layouts.intern(sheet.layouts.name(id)));
+  }
+
+  for (int s = 0; s < inputs.size(); ++s)
+  {
+    const DynamicArray< Structures::Node >& v = inputs[s]->contents;
+    int runStart = 0;
+    for (int i = 1; i <= v.size(); ++i)
+    {
+      if (i == v.size() || v[i].time.start < v[i - 1].time.start)
+      {
+        heap.push(Cursor(v[runStart].time.start, s, runStart, i));
+        runStart = i;
+      }
+    }
+  }
+
+  DynamicArray< Structures::Node > merged(arena.get());
+  merged.reserve(total);
+  while (!heap.empty())
+  {
+    const Cursor top = heap.top();
+    heap.pop();
+    const int s = get< 1 >(top);
+    const int pos = get< 2 >(top);
+    const int runEnd = get< 3 >(top);
+    const DynamicArray< Structures::Node >& v = inputs[s]->contents;
+    merged.push_back(v[pos]);
+    Structures::Node& added = merged[merged.size() - 1];
+    added.style = styleIds[s][added.style];
+    added.actor = actorIds[s][added.actor];
+    added.layout = layoutIds[s][added.layout];
+    if (pos + 1 < runEnd)
+      heap.push(Cursor(v[pos + 1].time.start, s, pos + 1, runEnd));
+  }
+  contents = std::move(merged);
+}
+
+void Subtitle::normalize()
+{
+  const int n = contents.size();
+  if (n < 2)
+    return;
+
+  vector< int > order(n);
+  vector< int > buffer(n);
+  for (int i = 0; i < n; ++i)
+    order[i] = i;
+
+  radixSortBy(order, buffer, [&](int i) { return contents[i].time.layer; });
+  radixSortBy(order, buffer, [&](int i) { return contents[i].time.end; });
+  radixSortBy(order, buffer, [&](int i) { return contents[i].time.start; });
+
+  // Apply the permutation cycle by cycle so each Node is moved exactly once.
+  vector< bool > placed(n, false);
+  for (int i = 0; i < n; ++i)
+  {
+    if (placed[i] || order[i] == i)
+      continue;
+    Structures::Node held = std::move(contents[i]);
+    int j = i;
+    while (true)
+    {
+      placed[j] = true;
+      const int k = order[j];
+      if (k == i)
+      {
+        contents[j] = std::move(held);
+        break;
+      }
+      contents[j] = std::move(contents[k]);
+      j = k;
+    }
+  }
+}
+
+void Subtitle::applyFormat()
+{
+  if (transform.isIdentity())
+    return;
+  for (auto& node : contents)
+  {
+    node.dialogue = makeText(transform.apply(node.dialogue));
+  }
+  transform = TextTransform();
+}
@@ -1,25 +1,34 @@
 #include "TTML.h"
 
+#include "Scanner.h"
+
 #include <regex>
 #include <string>
 
+using namespace std;
+
 Structures::Time TTML::timeParse(const string &s)
 {
 	Structures::Time t;
-	std::regex pattern("<p begin=\"(\\d{2}):(\\d{2}):(\\d{2})\\.(\\d{2,3})\" "
-					   "end=\"(\\d{2}):(\\d{2}):(\\d{2})\\.(\\d{2,3})\"");
-	std::smatch match;
-	if (!std::regex_search(s, match, pattern))
+	const size_t pos = Scanner::find(s, "<p begin=\"", 10);
+	if (pos == string::npos)
 	{
 		return t;
 	}
-
-	std::string startStr = match.str(1) + ":" + match.str(2) + ":" + match.str(3) + "." + match.str(4);
-	std::string endStr = match.str(5) + ":" + match.str(6) + ":" + match.str(7) + "." + match.str(8);
-
-	t.start = Structures::Time::timeConverter(startStr);
-	t.end = Structures::Time::timeConverter(endStr);
-	return t;
+	const size_t beginStart = pos + 10;
+	const size_t beginEnd = s.find('"', beginStart);
+	if (beginEnd == string::npos || s.compare(beginEnd, 7, "\" end=\"") != 0)
+	{
+		return t;
+	}
+	const size_t endStart = beginEnd + 7;
+	const size_t endEnd = s.find('"', endStart);
+	if (endEnd == string::npos)
+	{
+		return t;
+	}
+	return Structures::Time::fromClocks(s.data() + beginStart, beginEnd - beginStart, s.data() + endStart,
+										endEnd - endStart);
 }
 
 string TTML::dialogueParse(const string &s)
@@ -28,53 +37,98 @@ string TTML::dialogueParse(const string &s)
 	return dialogue;
 }
 
-void TTML::fileParse(istream &f)
+void TTML::bufferParse(const string &buffer)
 {
-	string line, fullContent;
+	presize(buffer);
+	const char open[] = "<p begin=\"";
+	const size_t openLength = sizeof(open) - 1;
 
-	while (getline(f, line))
+	size_t pos = 0;
+	while ((pos = Scanner::find(buffer, open, openLength, pos)) != string::npos)
 	{
-		fullContent += line + "\n";
-	}
-
-	std::regex pattern("<p begin=\"([^\"]+)\" end=\"([^\"]+)\">(.*?)</p>");
-	std::smatch match;
+		const size_t beginStart = pos + openLength;
+		const size_t beginEnd = buffer.find('"', beginStart);
+		if (beginEnd == string::npos || beginEnd == beginStart || buffer.compare(beginEnd, 7, "\" end=\"") != 0)
+		{
+			++pos;
+			continue;
+		}
+		const size_t endStart = beginEnd + 7;
+		const size_t endEnd = buffer.find('"', endStart);
+		if (endEnd == string::npos || endEnd == endStart || buffer.compare(endEnd, 2, "\">") != 0)
+		{
+			++pos;
+			continue;
+		}
+		const size_t textStart = endEnd + 2;
+		const size_t close = Scanner::find(buffer, "</p>", 4, textStart);
+		const size_t newline = buffer.find('\n', textStart);
+		if (close == string::npos || (newline != string::npos && newline < close))
+		{
+			++pos;
+			continue;
+		}
 
-	auto begin = fullContent.cbegin();
-	while (std::regex_search(begin, fullContent.cend(), match, pattern))
-	{
 		Structures::Node sub;
-		sub.time = timeParse(match.str(1));
-		sub.dialogue = match.str(3);
+		sub.time = timeParse(buffer.substr(pos, textStart - pos));
+		sub.dialogue = makeText(buffer.data() + textStart, close - textStart);
 
 		if (!sub.time.isEmpty() && !sub.dialogue.empty())
 		{
-			contents.push_back(sub);
+			contents.push_back(std::move(sub));
 		}
-		begin = match[0].second;
+		pos = close + 4;
 	}
 }
 
+size_t TTML::estimateCues(const string &buffer) const
+{
+	return Scanner::count(buffer.data(), buffer.size(), "<p begin=\"", 10);
+}
+
+size_t TTML::completeLength(const string &buffer) const
+{
+	const size_t pos = buffer.rfind("</p>");
+	if (pos == string::npos)
+		return 0;
+	return pos + 4;
+}
+
 void TTML::deleteFormat()
 {
-	std::regex pattern("<[^>]+>");
+	if (lazyFormat)
+	{
+		transform.strip(TextTransform::Tags);
+		return;
+	}
+	static const std::regex pattern("<[^>]+>");
 	for (auto &k : contents)
 	{
-		k.dialogue = std::regex_replace(k.dialogue, pattern, "");
+		k.dialogue = makeText(std::regex_replace(k.dialogue.str(), pattern, ""));
 	}
 }
 
 void TTML::setFormat()
 {
+	if (lazyFormat)
+	{
+		transform.wrap("<span style=\"italic\">", "</span>");
+		return;
+	}
 	for (auto &k : contents)
 	{
-		k.dialogue = "<span style=\"italic\">" + k.dialogue + "</span>";
+		k.dialogue = makeText("<span style=\"italic\">" + k.dialogue + "</span>");
 	}
 }
 
-DynamicArray< Structures::Node > TTML::getCollisions()
+bool TTML::collides(const Structures::Node &first, const Structures::Node &second) const
+{
+	return first.time.start < second.time.end && second.time.start < first.time.end;
+}
+
+DynamicArray< Structures::Node > TTML::getCollisions() const
 {
-	DynamicArray< Structures::Node > collisions;
+	DynamicArray< Structures::Node > collisions(&PoolAllocator::shared());
 	const int n = contents.size();
 
 	for (int i = 0; i < n; ++i)
@@ -84,7 +138,7 @@ DynamicArray< Structures::Node > TTML::getCollisions()
 			const Structures::Node &first = contents[i];
 			const Structures::Node &second = contents[j];
 
-			if (first.time.start < second.time.end && second.time.start < first.time.end)
+			if (collides(first, second))
 			{
 				collisions.push_back(first);
 				collisions.push_back(second);
@@ -0,0 +1,302 @@
+#include "Transcode.h"
+
+#include "Scanner.h"
+#include "SubtitleFactory.h"
+
+#include <cctype>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+// Orders cues as Subtitle::normalize does; the fast paths only take input that is already sorted.
+class OrderCheck
+{
+private:
+  Structures::Time last;
+  bool first = true;
+
+public:
+  bool next(const Structures::Time& t)
+  {
+    const bool ordered = first || last.start < t.start ||
+                         (last.start == t.start && (last.end < t.end || (last.end == t.end && last.layer <= t.layer)));
+    last = t;
+    first = false;
+    return ordered;
+  }
+};
+
+template< typename Stamp > void appendStamp(std::string& out, Structures::Ticks ms)
+{
+  char buffer[32];
+  out.append(buffer, Stamp::format(buffer, ms));
+}
+
+void appendIndex(std::string& out, size_t index)
+{
+  char buffer[24];
+  char* end = buffer + sizeof(buffer);
+  char* p = end;
+  do
+  {
+    *--p = (char)('0' + index % 10);
+    index /= 10;
+  } while (index);
+  out.append(p, end - p);
+}
+
+bool startsWith(const char* line, size_t length, const char* prefix, size_t prefixLength)
+{
+  return length >= prefixLength && memcmp(line, prefix, prefixLength) == 0;
+}
+
+// SRT::timeParse on a line that is not copied into a string.
+Structures::Time srtTime(const char* line, size_t length)
+{
+  for (size_t pos = 0; pos < length; ++pos)
+  {
+    pos += Scanner::find(line + pos, length - pos, " --> ", 5);
+    if (pos >= length)
+      break;
+    const Structures::Time t = Structures::Time::fromArrow(line, length, pos);
+    if (!t.isEmpty())
+      return t;
+  }
+  return Structures::Time();
+}
+
+// SSA::timeParse for a line known to start with "Dialogue:".
+Structures::Time ssaTime(const char* line, size_t length)
+{
+  size_t pos = 9;
+  while (pos < length && isspace((unsigned char)line[pos]))
+    ++pos;
+  int layer = 0;
+  const size_t layerStart = pos;
+  while (pos < length && isdigit((unsigned char)line[pos]))
+    layer = layer * 10 + (line[pos++] - '0');
+  if (pos == layerStart || pos >= length || line[pos] != ',')
+    return Structures::Time();
+  const size_t beginStart = pos + 1;
+  const char* beginEnd = static_cast< const char* >(memchr(line + beginStart, ',', length - beginStart));
+  if (!beginEnd)
+    return Structures::Time();
+  const size_t finishStart = beginEnd - line + 1;
+  const char* finishEnd = static_cast< const char* >(memchr(line + finishStart, ',', length - finishStart));
+  const size_t finish = finishEnd ? finishEnd - line : length;
+  return Structures::Time::fromClocks(line + beginStart, beginEnd - line - beginStart, line + finishStart,
+                                      finish - finishStart, layer);
+}
+
+bool hasCapital(const char* line, size_t length)
+{
+  for (size_t i = 0; i < length; ++i)
+  {
+    if (line[i] >= 'A' && line[i] <= 'Z')
+      return true;
+  }
+  return false;
+}
+
+// Calls cue(time, text, length) for every cue SRT::fileParse would keep, in order; false when
+// the cues are not in normalize() order.
+template< typename Cue > bool scanSRT(const std::string& input, Cue cue)
+{
+  Scanner::LineCursor lines(input);
+  // Lines without the CR of a CRLF break, as SRT::fileParse reads them.
+  auto next = [&lines](const char*& line, size_t& length) {
+    if (!lines.next(line, length))
+      return false;
+    if (length != 0 && line[length - 1] == '\r')
+      --length;
+    return true;
+  };
+  OrderCheck order;
+  std::string joined;
+  const char* line;
+  size_t length;
+  while (next(line, length))
+  {
+    if (length == 0)
+      continue;
+    const char* timeLine;
+    size_t timeLength;
+    if (!next(timeLine, timeLength))
+      break;
+    const Structures::Time t = srtTime(timeLine, timeLength);
+
+    // While every line is kept and ends in a bare LF the dialogue is one span of the input;
+    // SRT::fileParse drops lines without a capital letter and joins lines with LF, and from
+    // the first line that breaks the span the text is rebuilt its way.
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    bool spanning = true;
+    while (next(line, length) && length != 0)
+    {
+      const bool kept = hasCapital(line, length);
+      if (spanning && kept && (!begin || *end == '\n'))
+      {
+        if (!begin)
+          begin = line;
+        end = line + length;
+        continue;
+      }
+      if (spanning)
+      {
+        joined.assign(begin, begin ? end - begin : 0);
+        spanning = false;
+      }
+      if (!joined.empty())
+        joined += '\n';
+      if (kept)
+        joined.append(line, length);
+    }
+    const char* text = spanning ? begin : joined.data();
+    const size_t textLength = spanning ? (begin ? end - begin : 0) : joined.size();
+    if (t.isEmpty() || textLength == 0)
+      continue;
+    if (!order.next(t))
+      return false;
+    cue(t, text, textLength);
+  }
+  return true;
+}
+
+template< typename Format > std::string frame(bool header)
+{
+  std::ostringstream out;
+  if (header)
+    Format::header(out, Structures::StyleSheet());
+  else
+    Format::footer(out);
+  return out.str();
+}
+
+// SRT output of one cue, as SRTFormat writes it.
+void appendSRT(std::string& output, size_t index, const Structures::Time& t, const char* text, size_t length)
+{
+  typedef SRTFormat::Stamp Stamp;
+  appendIndex(output, index);
+  output += '\n';
+  appendStamp< Stamp >(output, t.start);
+  output += " --> ";
+  appendStamp< Stamp >(output, t.end);
+  output += '\n';
+  output.append(text, length);
+  output += "\n\n";
+}
+}
+
+namespace Transcode
+{
+bool srtToTtml(const std::string& input, std::string& output)
+{
+  typedef TTMLFormat::Stamp Stamp;
+  output = frame< TTMLFormat >(true);
+  output.reserve(input.size() + input.size() / 2);
+  const bool ordered = scanSRT(input, [&](const Structures::Time& t, const char* text, size_t length) {
+    output += "<p begin=\"";
+    appendStamp< Stamp >(output, t.start);
+    output += "\" end=\"";
+    appendStamp< Stamp >(output, t.end);
+    output += "\">";
+    output.append(text, length);
+    output += "</p>\n";
+  });
+  output += frame< TTMLFormat >(false);
+  return ordered;
+}
+
+bool srtToVtt(const std::string& input, std::string& output)
+{
+  typedef VTTFormat::Stamp Stamp;
+  output = frame< VTTFormat >(true);
+  output.reserve(input.size() + 16);
+  return scanSRT(input, [&](const Structures::Time& t, const char* text, size_t length) {
+    appendStamp< Stamp >(output, t.start);
+    output += " --> ";
+    appendStamp< Stamp >(output, t.end);
+    output += '\n';
+    output.append(text, length);
+    output += "\n\n";
+  });
+}
+
+bool vttToSrt(const std::string& input, std::string& output)
+{
+  output.clear();
+  output.reserve(input.size() + input.size() / 8);
+  VTT::CueCursor cues(input);
+  OrderCheck order;
+  size_t index = 0;
+  Structures::Time t;
+  const char* text;
+  size_t length;
+  while (cues.next(t, text, length))
+  {
+    if (t.isEmpty() || length == 0)
+      continue;
+    if (!order.next(t))
+      return false;
+    appendSRT(output, ++index, t, text, length);
+  }
+  return true;
+}
+
+bool ssaToSrt(const std::string& input, std::string& output)
+{
+  output.clear();
+  output.reserve(input.size());
+
+  Scanner::LineCursor lines(input);
+  OrderCheck order;
+  bool inStyles = false;
+  size_t index = 0;
+  const char* line;
+  size_t length;
+  while (lines.next(line, length))
+  {
+    if (length != 0 && line[0] == '[')
+    {
+      inStyles = startsWith(line, length, "[V4+ Styles]", 12) || startsWith(line, length, "[V4 Styles]", 11);
+      continue;
+    }
+    if (inStyles || Scanner::find(line, length, "Dialogue", 8) == length)
+      continue;
+
+    // Anything SSA::fileParse would keep with an empty time or a placeholder text goes the generic way.
+    if (!startsWith(line, length, "Dialogue:", 9))
+      return false;
+    const Structures::Time t = ssaTime(line, length);
+    if (t.isEmpty() || !order.next(t))
+      return false;
+    size_t text = 9;
+    for (int field = 0; field < 9; ++field)
+    {
+      const char* comma = static_cast< const char* >(memchr(line + text, ',', length - text));
+      if (!comma)
+        return false;
+      text = comma - line + 1;
+    }
+    if (memchr(line + text, '\r', length - text))
+      return false;
+
+    appendSRT(output, ++index, t, line + text, length - text);
+  }
+  return true;
+}
+
+Path find(const SubtitleFormat* from, const SubtitleFormat* to)
+{
+  if (from == SubtitleFactory::find(".srt") && to == SubtitleFactory::find(".ttml"))
+    return &srtToTtml;
+  if (from == SubtitleFactory::find(".ass") && to == SubtitleFactory::find(".srt"))
+    return &ssaToSrt;
+  if (from == SubtitleFactory::find(".srt") && to == SubtitleFactory::find(".vtt"))
+    return &srtToVtt;
+  if (from == SubtitleFactory::find(".vtt") && to == SubtitleFactory::find(".srt"))
+    return &vttToSrt;
+  return nullptr;
+}
+}
@@ -0,0 +1,237 @@
+#include "VTT.h"
+
+#include <cctype>
+#include <cstring>
+#include <regex>
+#include <string>
+
+using namespace std;
+
+namespace
+{
+bool startsWith(const char *line, size_t length, const char *prefix, size_t prefixLength)
+{
+	return length >= prefixLength && memcmp(line, prefix, prefixLength) == 0;
+}
+
+// "NOTE", "STYLE" or "REGION" alone or followed by a space or tab.
+bool blockHeader(const char *line, size_t length, const char *keyword, size_t keywordLength)
+{
+	return startsWith(line, length, keyword, keywordLength) &&
+		   (length == keywordLength || line[keywordLength] == ' ' || line[keywordLength] == '\t');
+}
+
+// Hours are optional in WebVTT; a "MM:SS.mmm" clock is read as "0:MM:SS.mmm".
+bool clockParse(const char *p, size_t n, Structures::Ticks &milliseconds)
+{
+	const char *colon = static_cast< const char * >(memchr(p, ':', n));
+	if (colon && !memchr(colon + 1, ':', n - (colon + 1 - p)))
+	{
+		char clock[32] = { '0', ':' };
+		if (n + 2 > sizeof(clock))
+			return false;
+		memcpy(clock + 2, p, n);
+		return Structures::Time::clockParse(clock, n + 2, milliseconds);
+	}
+	return Structures::Time::clockParse(p, n, milliseconds);
+}
+}
+
+bool VTT::CueCursor::nextLine(const char *&line, size_t &length)
+{
+	if (!lines.next(line, length))
+		return false;
+	if (length > 0 && line[length - 1] == '\r')
+		--length;
+	return true;
+}
+
+void VTT::CueCursor::skipBlock()
+{
+	const char *line;
+	size_t length;
+	while (nextLine(line, length) && length != 0)
+		;
+}
+
+bool VTT::CueCursor::next(Structures::Time &time, const char *&text, size_t &length)
+{
+	const char *line;
+	size_t n;
+	while (nextLine(line, n))
+	{
+		if (n == 0)
+			continue;
+		const bool header = first && startsWith(line, n, "WEBVTT", 6);
+		first = false;
+		if (header || blockHeader(line, n, "NOTE", 4) || blockHeader(line, n, "STYLE", 5) ||
+			blockHeader(line, n, "REGION", 6))
+		{
+			skipBlock();
+			continue;
+		}
+
+		// An optional identifier line comes before the timing line.
+		if (Scanner::find(line, n, "-->", 3) == n)
+		{
+			if (!nextLine(line, n))
+				return false;
+			if (Scanner::find(line, n, "-->", 3) == n)
+			{
+				if (n != 0)
+					skipBlock();
+				continue;
+			}
+		}
+		time = timingParse(line, n);
+
+		text = line + n;
+		length = 0;
+		bool crlf = false;
+		const char *textLine;
+		size_t textLength;
+		while (nextLine(textLine, textLength) && textLength != 0)
+		{
+			if (length == 0)
+				text = textLine;
+			else if (text[length] == '\r')
+				crlf = true;
+			length = textLine + textLength - text;
+		}
+		// CRLF breaks between the lines of a cue are copied out as plain '\n'.
+		if (crlf)
+		{
+			joined.clear();
+			for (size_t i = 0; i < length; ++i)
+				if (text[i] != '\r' || i + 1 == length || text[i + 1] != '\n')
+					joined += text[i];
+			text = joined.data();
+			length = joined.size();
+		}
+		return true;
+	}
+	return false;
+}
+
+Structures::Time VTT::timingParse(const char *line, size_t length)
+{
+	const size_t arrow = Scanner::find(line, length, "-->", 3);
+	if (arrow == length)
+		return Structures::Time();
+	size_t beginStart = 0;
+	while (beginStart < arrow && isspace((unsigned char)line[beginStart]))
+		++beginStart;
+	size_t beginEnd = arrow;
+	while (beginEnd > beginStart && isspace((unsigned char)line[beginEnd - 1]))
+		--beginEnd;
+	size_t endStart = arrow + 3;
+	while (endStart < length && isspace((unsigned char)line[endStart]))
+		++endStart;
+	size_t endEnd = endStart;
+	while (endEnd < length && !isspace((unsigned char)line[endEnd]))
+		++endEnd;
+
+	Structures::Ticks start = 0, end = 0;
+	if (!clockParse(line + beginStart, beginEnd - beginStart, start) || !clockParse(line + endStart, endEnd - endStart, end))
+		return Structures::Time();
+	return Structures::Time(0, start, end);
+}
+
+Structures::Time VTT::timeParse(const string &s)
+{
+	return timingParse(s.data(), s.size());
+}
+
+string VTT::dialogueParse(const string &s)
+{
+	return s;
+}
+
+void VTT::bufferParse(const string &buffer)
+{
+	presize(buffer);
+	CueCursor cues(buffer);
+	Structures::Node sub;
+	const char *text;
+	size_t length;
+	while (cues.next(sub.time, text, length))
+	{
+		if (sub.time.isEmpty() || length == 0)
+			continue;
+		sub.dialogue = makeText(text, length);
+		contents.push_back(std::move(sub));
+		sub = Structures::Node();
+	}
+}
+
+size_t VTT::estimateCues(const string &buffer) const
+{
+	return Scanner::count(buffer.data(), buffer.size(), " --> ", 5);
+}
+
+size_t VTT::completeLength(const string &buffer) const
+{
+	return pastLastBlankLine(buffer);
+}
+
+// The WEBVTT block is only recognised at the start of a document, so it stays in the first chunk.
+size_t VTT::headerLength(const string &buffer) const
+{
+	if (buffer.compare(0, 6, "WEBVTT") != 0)
+		return 0;
+	return pastFirstBlankLine(buffer);
+}
+
+void VTT::deleteFormat()
+{
+	if (lazyFormat)
+	{
+		transform.strip(TextTransform::Tags);
+		return;
+	}
+	static const regex pattern("<[^>]+>");
+	for (auto &k : contents)
+	{
+		k.dialogue = makeText(regex_replace(k.dialogue.str(), pattern, ""));
+	}
+}
+
+void VTT::setFormat()
+{
+	if (lazyFormat)
+	{
+		transform.wrap("<i>", "</i>");
+		return;
+	}
+	for (auto &k : contents)
+	{
+		k.dialogue = makeText("<i>" + k.dialogue + "</i>");
+	}
+}
+
+bool VTT::collides(const Structures::Node &first, const Structures::Node &second) const
+{
+	return first.time.start < second.time.end && second.time.start < first.time.end;
+}
+
+DynamicArray< Structures::Node > VTT::getCollisions() const
+{
+	DynamicArray< Structures::Node > collisions(&PoolAllocator::shared());
+	const int n = contents.size();
+
+	for (int i = 0; i < n; ++i)
+	{
+		for (int j = i + 1; j < n; ++j)
+		{
+			const Structures::Node &first = contents[i];
+			const Structures::Node &second = contents[j];
+
+			if (collides(first, second))
+			{
+				collisions.push_back(first);
+				collisions.push_back(second);
+			}
+		}
+	}
+	return collisions;
+}
@@ -1,8 +1,16 @@
+#include "BatchConverter.h"
+#include "Encoding.h"
+#include "MappedFile.h"
+#include "Segmenter.h"
 #include "SubtitleFactory.h"
+#include "Transcode.h"
 
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 
+using namespace std;
+
 string getFileExtension(const string& filename)
 {
   size_t dotPosition = filename.rfind('.');
@@ -13,32 +21,92 @@ string getFileExtension(const string& filename)
   return filename.substr(dotPosition);
 }
 
-string fileDetection(ifstream& in)
+int main(int argc, char* argv[])
 {
-  string line;
-  getline(in, line);
-  line.erase(0, line.find_first_not_of(" \t\r\n"));
-  line.erase(line.find_last_not_of(" \t\r\n") + 1);
-  if (line == "0" || line == "1")
-  {
-    return ".srt";
-  }
-  else if (line == "<SAMI>")
+  // --batch in1 out1 in2 out2 ... converts every pair on all cores.
+  if (argc > 1 && string(argv[1]) == "--batch")
   {
-    return ".smi";
+    vector< ConversionJob > jobs;
+    for (int i = 2; i + 1 < argc; i += 2)
+      jobs.push_back({ argv[i], argv[i + 1] });
+    BatchConverter converter;
+    converter.convert(jobs);
+    for (const auto& path : converter.getFailures())
+      cout << "Failed to convert " << path << "\n";
+    return converter.getFailures().empty() ? 0 : 1;
   }
-  else if (line == "[Script Info]")
+
+  // --segment seconds in out.vtt writes out00000.vtt, out00001.vtt, ... and out.m3u8.
+  if (argc > 4 && string(argv[1]) == "--segment")
   {
-    return ".ass";
+    const SubtitleFormat* source = SubtitleFactory::find(getFileExtension(argv[3]));
+    const string output = argv[4];
+    const string extension = getFileExtension(output);
+    const SubtitleFormat* target = SubtitleFactory::find(extension);
+    ifstream segmentInput(argv[3], ios::binary);
+    if (!source || !target || !segmentInput.is_open())
+    {
+      cout << "Failed to open " << argv[3] << "\n";
+      return 1;
+    }
+    try
+    {
+      Encoding::DecodingStream document(segmentInput);
+      auto sub = source->create();
+      sub->fileParse(document);
+      sub->normalize();
+      const Structures::Ticks duration = (Structures::Ticks)(atof(argv[2]) * 1000);
+      const size_t segments = HLS::writeSegments(sub->getContents(), *target->makeWriter(), duration,
+                                                 output.substr(0, output.size() - extension.size()), extension,
+                                                 sub->getStyles());
+      cout << segments << " segments\n";
+    }
+    catch (const exception& e)
+    {
+      cout << e.what() << "\n";
+      return 1;
+    }
+    return 0;
   }
-  else
+
+  // --range from to in out keeps the cues overlapping [from, to), e.g. 0:10:00.000 0:12:00.000.
+  // Sorted SRT and SSA inputs are searched in place, so only the window is read and parsed.
+  if (argc > 5 && string(argv[1]) == "--range")
   {
-    return ".unknown";
+    const SubtitleFormat* source = SubtitleFactory::find(getFileExtension(argv[4]));
+    const SubtitleFormat* target = SubtitleFactory::find(getFileExtension(argv[5]));
+    if (!source || !target)
+    {
+      cout << "Unsupported format\n";
+      return 1;
+    }
+    try
+    {
+      const Structures::Ticks from = Structures::Time::timeConverter(argv[2]);
+      const Structures::Ticks to = Structures::Time::timeConverter(argv[3]);
+      MappedFile file(argv[4]);
+      size_t bom = 0;
+      const Encoding::Charset charset = Encoding::sniff(file.data(), file.size(), bom);
+      auto sub = source->create();
+      if (charset == Encoding::Charset::UTF8)
+        sub->rangeParse(file.data() + bom, file.size() - bom, from, to);
+      else
+      {
+        const string text = Encoding::toUtf8(string(file.data(), file.size()), charset);
+        sub->rangeParse(text.data(), text.size(), from, to);
+      }
+      sub->normalize();
+      ofstream rangeOutput(argv[5]);
+      target->makeWriter()->write(rangeOutput, sub->getContents(), sub->getStyles(), sub->getTransform());
+    }
+    catch (const exception& e)
+    {
+      cout << e.what() << "\n";
+      return 1;
+    }
+    return 0;
   }
-}
 
-int main(int argc, char* argv[])
-{
   ifstream in(argv[1]);
   ofstream out(argv[2]);
   if (!in.is_open())
@@ -46,29 +114,36 @@ int main(int argc, char* argv[])
     cout << "Failed to open file " << argv[1] << "\n";
     return 1;
   }
-  string format = fileDetection(in);
-  SubtitleFactory s;
-  auto sub = s.create(format);
-  sub->fileParse(in);
-  string extension = getFileExtension(argv[2]);
-  if (extension == ".srt")
-  {
-    unique_ptr< WriteBehavior > writer = make_unique< toSRT >();
-    writer->write(out, sub->getContents());
-  }
-  else if (extension == ".smi")
+  Encoding::Charset charset = Encoding::Charset::Auto;
+  if (argc > 3 && !Encoding::fromName(argv[3], charset))
   {
-    unique_ptr< WriteBehavior > writer = make_unique< toSAMI >();
-    writer->write(out, sub->getContents());
+    cout << "Unknown encoding " << argv[3] << "\n";
+    return 1;
   }
-  else if (extension == ".ass")
+  // Decoded once; the fast path and the parser both read this buffer.
+  const string text = Encoding::readUtf8(in, charset);
+
+  // The first line names the format; the extension is the fallback, e.g. for TTML.
+  const SubtitleFormat* source = SubtitleFactory::sniff(text);
+  if (!source)
+    source = SubtitleFactory::find(getFileExtension(argv[1]));
+  const SubtitleFormat* target = SubtitleFactory::find(getFileExtension(argv[2]));
+  if (!source || !target)
   {
-    unique_ptr< WriteBehavior > writer = make_unique< toSSA >();
-    writer->write(out, sub->getContents());
+    cout << "Unsupported format\n";
+    return 1;
   }
-  else if (extension == ".ttml")
+
+  const Transcode::Path direct = Transcode::find(source, target);
+  string converted;
+  if (direct && direct(text, converted))
   {
-    unique_ptr< WriteBehavior > writer = make_unique< toTTML >();
-    writer->write(out, sub->getContents());
+    out << converted;
+    return 0;
   }
+
+  auto sub = source->create();
+  sub->bufferParse(text);
+  sub->normalize();
+  target->makeWriter()->write(out, sub->getContents(), sub->getStyles(), sub->getTransform());
 }
@@ -1,11 +1,27 @@
+#include "BatchConverter.h"
+#include "CollisionTracker.h"
 #include "DynamicArray.h"
+#include "Encoding.h"
+#include "Scanner.h"
+#include "Scheduler.h"
+#include "Segmenter.h"
 #include "Structures.h"
 #include "SubtitleFactory.h"
+#include "Transcode.h"
 #include "WriteBehavior.h"
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <regex>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 using namespace std;
 
@@ -59,6 +75,26 @@ TEST(SubtitleFactoryTest, TTMLCreation)
 	EXPECT_TRUE(dynamic_cast< TTML * >(sub.get()) != nullptr);
 }
 
+TEST(SubtitleFactoryTest, RegistryResolvesExtensionsAndSignatures)
+{
+	size_t count;
+	const SubtitleFormat *table = SubtitleFactory::formats(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		EXPECT_EQ(SubtitleFactory::find(table[i].extension), &table[i]);
+		EXPECT_NE(table[i].create(), nullptr);
+	}
+	EXPECT_EQ(SubtitleFactory::find(".vob"), nullptr);
+	EXPECT_EQ(SubtitleFactory::create(".vob"), nullptr);
+	EXPECT_EQ(SubtitleFactory::sniff(" 1\r"), SubtitleFactory::find(".srt"));
+	EXPECT_EQ(SubtitleFactory::sniff("[Script Info]"), SubtitleFactory::find(".ass"));
+	EXPECT_EQ(SubtitleFactory::sniff("<SAMI>"), SubtitleFactory::find(".smi"));
+	EXPECT_EQ(SubtitleFactory::sniff("<?xml version=\"1.0\"?>"), nullptr);
+	EXPECT_EQ(SubtitleFactory::sniff("WEBVTT\r\n\r\n00:01.000 --> 00:02.000\r\nHi\r\n"), SubtitleFactory::find(".vtt"));
+	EXPECT_EQ(SubtitleFactory::sniff("\n[Script Info]\n"), nullptr);
+	EXPECT_EQ(SubtitleFactory::sniff("10\n00:00:01,000 --> 00:00:02,000\n"), nullptr);
+}
+
 TEST(WriteBehaviorTest, toSRT_WritesCorrectFormat)
 {
 	toSRT writer;
@@ -136,6 +172,82 @@ TEST(WriteBehaviorTest, toTTML_WritesCorrectFormat)
 	EXPECT_EQ(out.str(), expected);
 }
 
+TEST(WriteBehaviorTest, WriteToStringMatchesStreamOutput)
+{
+	DynamicArray< Structures::Node > nodes = { { { 0, 1000, 2000 }, "<b>First</b>" },
+											   { { 0, 3000, 4000 }, "Second\nline" },
+											   { { 12, 360000000, 3600000000LL }, "<P>Own paragraph" },
+											   { { 0, -1500, 500 }, "{\\an8}" } };
+	Structures::StyleSheet parsed;
+	parsed.format = "Format: Name, Fontname";
+	nodes[1].style = parsed.addStyle("Signs", 5);
+	nodes[1].actor = parsed.actors.intern("Anna");
+	nodes[2].layout = parsed.layouts.intern("10,20,30,Scroll up");
+	Pipeline plain, stripped, wrapped;
+	stripped.strip(TextTransform::BracesAndTags).wrap("<i>", "</i>");
+	wrapped.wrap("<i>", "</i>").wrap("<b>", "</b>").dropEmpty().shift(250);
+	toSRT srt;
+	toSAMI sami;
+	toSSA ssa;
+	toTTML ttml;
+	toVTT vtt;
+	for (const WriteBehavior *writer : { (const WriteBehavior *)&srt, (const WriteBehavior *)&sami,
+										 (const WriteBehavior *)&ssa, (const WriteBehavior *)&ttml,
+										 (const WriteBehavior *)&vtt })
+	{
+		for (const Pipeline *pipeline : { &plain, &stripped, &wrapped })
+		{
+			for (const Structures::StyleSheet &styles : { Structures::StyleSheet(), parsed })
+			{
+				ostringstream out;
+				writer->write(out, nodes, styles, *pipeline);
+				const string written = writer->writeToString(nodes, styles, *pipeline);
+				EXPECT_EQ(written, out.str());
+				EXPECT_EQ(writer->measure(nodes, styles, *pipeline), written.size());
+			}
+		}
+	}
+
+	char small[8];
+	EXPECT_EQ(srt.writeTo(small, sizeof(small), nodes), sizeof(small));
+	EXPECT_EQ(string(small, 8), "1\n00:00:");
+}
+
+TEST(WriteBehaviorTest, ParallelWriteMatchesSequentialWrite)
+{
+	DynamicArray< Structures::Node > nodes;
+	for (int i = 0; i < 1000; ++i)
+		nodes.push_back(Structures::Node({ 0, i * 1000, i * 1000 + 900 }, i % 7 == 0 ? "<i></i>" : "<i>Line</i>"));
+	Pipeline pipeline;
+	pipeline.strip(TextTransform::BracesAndTags).dropEmpty();
+	WorkStealingScheduler scheduler(3);
+	toSRT srt;
+	toSAMI sami;
+	toSSA ssa;
+	toTTML ttml;
+	for (const WriteBehavior *writer : { (const WriteBehavior *)&srt, (const WriteBehavior *)&sami,
+										 (const WriteBehavior *)&ssa, (const WriteBehavior *)&ttml })
+	{
+		ostringstream sequential, parallel;
+		writer->write(sequential, nodes, Structures::StyleSheet(), pipeline);
+		writer->writeParallel(parallel, nodes, Structures::StyleSheet(), pipeline, scheduler, 64);
+		EXPECT_EQ(parallel.str(), sequential.str());
+	}
+}
+
+TEST(WriteBehaviorTest, ClockStampMatchesPrintfLayout)
+{
+	for (Structures::Ticks ms : { 0LL, 1LL, 59999LL, 3599999LL, 360000000LL, 3600000000LL, 123456789012LL, -1500LL })
+	{
+		ostringstream out;
+		ClockStamp< ',' >::put(out, ms);
+		char expected[64];
+		sprintf(expected, "%02lld:%02d:%02d,%03d", (long long)(ms / 3600000), (int)(ms % 3600000 / 60000),
+				(int)(ms % 60000 / 1000), (int)(ms % 1000));
+		EXPECT_EQ(out.str(), expected);
+	}
+}
+
 TEST(SRTDialogueParseTest, ReturnsInputWhenCapital)
 {
 	SRT srt;
@@ -188,6 +300,95 @@ TEST(SRTFileParseTest, ParsesSingleLineSubtitle)
 	EXPECT_EQ(node.dialogue, "Single line subtitle");
 }
 
+TEST(SRTAppendParseTest, ParsesOnlyCompleteCues)
+{
+	SRT srt;
+	srt.appendParse("1\n00:00:01,000 --> 00:00:02,000\nFirst\n\n2\n00:00:03,");
+	ASSERT_EQ(srt.getContents().size(), 1);
+	EXPECT_EQ(srt.getContents()[0].dialogue, "First");
+
+	srt.appendParse("000 --> 00:00:04,000\nSecond\n");
+	EXPECT_EQ(srt.getContents().size(), 1);
+
+	srt.appendParse("\n3\n00:00:05,000 --> 00:00:06,000\nThird");
+	ASSERT_EQ(srt.getContents().size(), 2);
+	EXPECT_EQ(srt.getContents()[1].time.start, 3000);
+	EXPECT_EQ(srt.getContents()[1].dialogue, "Second");
+
+	srt.finishParse();
+	ASSERT_EQ(srt.getContents().size(), 3);
+	EXPECT_EQ(srt.getContents()[2].dialogue, "Third");
+}
+
+TEST(SRTAppendParseTest, ParsesCRLFCuesAsTheyComplete)
+{
+	SRT srt;
+	srt.appendParse("1\r\n00:00:01,000 --> 00:00:02,000\r\nFirst\r\nLine\r\n\r\n2\r\n00:00:03,");
+	ASSERT_EQ(srt.getContents().size(), 1);
+	EXPECT_EQ(srt.getContents()[0].dialogue, "First\nLine");
+
+	srt.appendParse("000 --> 00:00:04,000\r\nSecond\r\n\r");
+	EXPECT_EQ(srt.getContents().size(), 1);
+
+	srt.appendParse("\n3\r\n00:00:05,000 --> 00:00:06,000\r\nThird");
+	ASSERT_EQ(srt.getContents().size(), 2);
+	EXPECT_EQ(srt.getContents()[1].time.start, 3000);
+	EXPECT_EQ(srt.getContents()[1].dialogue, "Second");
+
+	srt.finishParse();
+	ASSERT_EQ(srt.getContents().size(), 3);
+	EXPECT_EQ(srt.getContents()[2].dialogue, "Third");
+}
+
+TEST(SSAAppendParseTest, MatchesFileParse)
+{
+	std::string ssaData =
+		"[Events]\n"
+		"Dialogue: 0,0:00:01.00,0:00:02.00,Default,,0,0,0,,One\n"
+		"Dialogue: 0,0:00:03.00,0:00:04.00,Default,,0,0,0,,Two\n";
+
+	SSA whole;
+	std::istringstream iss(ssaData);
+	whole.fileParse(iss);
+
+	SSA incremental;
+	for (size_t i = 0; i < ssaData.size(); i += 7)
+		incremental.appendParse(ssaData.substr(i, 7));
+	incremental.finishParse();
+
+	ASSERT_EQ(incremental.getContents().size(), whole.getContents().size());
+	for (int i = 0; i < whole.getContents().size(); ++i)
+	{
+		EXPECT_EQ(incremental.getContents()[i].time.start, whole.getContents()[i].time.start);
+		EXPECT_EQ(incremental.getContents()[i].dialogue, whole.getContents()[i].dialogue);
+	}
+}
+
+TEST(TTMLFileParseTest, ParsesParagraphs)
+{
+	std::string ttmlData =
+		"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<tt xmlns=\"http://www.w3.org/ns/ttml\">\n"
+		"<body>\n"
+		"<div>\n"
+		"<p begin=\"00:00:01.250\" end=\"00:00:02.500\">First</p>\n"
+		"<p begin=\"broken\">\n"
+		"<p begin=\"00:00:03.000\" end=\"00:00:04.000\">Second</p>\n"
+		"</div>\n"
+		"</body>\n"
+		"</tt>\n";
+
+	std::istringstream iss(ttmlData);
+	TTML ttml;
+	ttml.fileParse(iss);
+
+	ASSERT_EQ(ttml.getContents().size(), 2);
+	EXPECT_EQ(ttml.getContents()[0].time.start, 1250);
+	EXPECT_EQ(ttml.getContents()[0].dialogue, "First");
+	EXPECT_EQ(ttml.getContents()[1].time.end, 4000);
+	EXPECT_EQ(ttml.getContents()[1].dialogue, "Second");
+}
+
 TEST(SAMIDialogueParseTest, ConvertsBRToNewline)
 {
 	SAMI sami;
@@ -197,6 +398,42 @@ TEST(SAMIDialogueParseTest, ConvertsBRToNewline)
 	EXPECT_EQ(result, expected);
 }
 
+TEST(TokenizerTest, ScansMatchTheRegexesTheyReplace)
+{
+	const regex paragraph(R"(<P[^>]*>(.*?)<\/P>)", regex_constants::icase);
+	const regex dialogue(R"(^Dialogue:\s*(?:[^,]*,){9}(.*)$)");
+	const regex sync(R"(<SYNC Start=(\d+)>)");
+	const string paragraphs[] = { "<P Class=ENUSCC>one<br>two</P>", "<p>lower</p>", "x<P\r>a</p> <P>b</P>",
+								  "<P>split\rline</P><P>next</P>", "<P>open only", "<P no close", "",
+								  "<P><P>nested</P>", "<Pre>tag</P>", "<P>a<br><br>b</P>" };
+	SAMI sami;
+	for (const string &input : paragraphs)
+	{
+		smatch match;
+		string expected = regex_search(input, match, paragraph) ? match.str(1) : "";
+		for (size_t pos; (pos = expected.find("<br>")) != string::npos;)
+			expected.replace(pos, 4, "\n");
+		EXPECT_EQ(sami.dialogueParse(input), expected) << input;
+	}
+	const string syncs[] = { "<SYNC Start=1500>", "<SYNC Start=>x<SYNC Start=20>", "<SYNC Start=12", "<Sync Start=5>" };
+	for (const string &input : syncs)
+	{
+		smatch match;
+		const Structures::Ticks expected = regex_search(input, match, sync) ? stoll(match.str(1)) : 0;
+		EXPECT_EQ(sami.timeParse(input).start, expected) << input;
+	}
+	const string lines[] = { "Dialogue: 0,0:00:01.00,0:00:02.00,Default,,0,0,0,,Text, with comma",
+							 "Dialogue: 0,0:00:01.00,0:00:02.00,Default,,0,0,0,Effect",
+							 "Dialogue: 0,0:00:01.00,0:00:02.00,Default,,0,0,0,,CR\r", " Dialogue: 0,1,2,3,4,5,6,7,8,x",
+							 "Dialogue:,,,,,,,,,", "Comment: 0,1,2,3,4,5,6,7,8,x" };
+	SSA ssa;
+	for (const string &input : lines)
+	{
+		smatch match;
+		EXPECT_EQ(ssa.dialogueParse(input), regex_search(input, match, dialogue) ? match.str(1) : " ") << input;
+	}
+}
+
 TEST(SRTGetCollisionsTest, FindsCollidingSubtitles)
 {
 	SRT srt;
@@ -227,6 +464,293 @@ TEST(SRTGetCollisionsTest, FindsCollidingSubtitles)
 	EXPECT_EQ(collisions[1].dialogue, "B");
 }
 
+TEST(CollisionTrackerTest, MatchesGetCollisionsAfterBuild)
+{
+	DynamicArray< Structures::Node > nodes = { { { 0, 1000, 5000 }, "A" },
+											   { { 0, 4000, 6000 }, "B" },
+											   { { 0, 7000, 9000 }, "C" } };
+	CollisionTracker tracker(nodes);
+
+	ASSERT_EQ(tracker.count(), 1);
+	EXPECT_TRUE(tracker.collides(0, 1));
+	EXPECT_FALSE(tracker.collides(1, 2));
+}
+
+TEST(CollisionTrackerTest, UpdatesPairsOnEdits)
+{
+	CollisionTracker tracker;
+	const int a = tracker.insert({ 0, 1000, 5000 });
+	const int b = tracker.insert({ 0, 4000, 6000 });
+	const int c = tracker.insert({ 1, 4000, 6000 });
+	EXPECT_TRUE(tracker.collides(a, b));
+	EXPECT_FALSE(tracker.collides(a, c));
+
+	tracker.shift(b, 2000);
+	EXPECT_EQ(tracker.count(), 0);
+
+	const int d = tracker.insert({ 0, 5500, 6500 });
+	EXPECT_TRUE(tracker.collides(b, d));
+
+	tracker.erase(b);
+	EXPECT_EQ(tracker.count(), 0);
+	EXPECT_FALSE(tracker.contains(b));
+}
+
+TEST(CollisionTrackerTest, ShiftRangeMatchesFullRescan)
+{
+	CollisionTracker tracker;
+	DynamicArray< Structures::Time > times;
+	unsigned state = 12345;
+	for (int i = 0; i < 200; ++i)
+	{
+		state = state * 1103515245u + 12345u;
+		const int start = (int)(state % 100000);
+		const int length = 500 + (int)((state >> 8) % 3000);
+		times.push_back({ (int)((state >> 4) % 2), start, start + length });
+		tracker.insert(times[i]);
+	}
+
+	tracker.shiftRange(20000, 60000, 1500);
+	tracker.shift(7, -4000);
+	tracker.erase(11);
+
+	int expected = 0;
+	for (int i = 0; i < times.size(); ++i)
+	{
+		for (int j = i + 1; j < times.size(); ++j)
+		{
+			if (!tracker.contains(i) || !tracker.contains(j))
+				continue;
+			const Structures::Time &x = tracker.getTime(i);
+			const Structures::Time &y = tracker.getTime(j);
+			const bool overlap = x.layer == y.layer && x.start < y.end && y.start < x.end;
+			EXPECT_EQ(tracker.collides(i, j), overlap);
+			expected += overlap;
+		}
+	}
+	EXPECT_EQ(tracker.count(), expected);
+}
+
+TEST(CollisionTrackerTest, RepeatedEditsMatchFullRescan)
+{
+	CollisionTracker tracker;
+	unsigned state = 99;
+	auto next = [&state](unsigned bound) {
+		state = state * 1103515245u + 12345u;
+		return (int)((state >> 8) % bound);
+	};
+	for (int i = 0; i < 120; ++i)
+	{
+		const int start = next(60000);
+		tracker.insert({ next(2), start, start + 200 + next(4000) });
+	}
+
+	for (int round = 0; round < 60; ++round)
+	{
+		const int from = next(60000);
+		switch (round % 4)
+		{
+		case 0:
+		case 1:
+			tracker.shiftRange(from, from + next(20000), next(30000) - 15000);
+			break;
+		case 2:
+			tracker.shift(next(120), next(6000) - 3000);
+			break;
+		default:
+			tracker.erase(next(120));
+			tracker.insert({ next(2), from, from + 1000 + next(3000) });
+		}
+
+		int expected = 0;
+		const int ids = 120 + round / 4 + 1;
+		for (int i = 0; i < ids; ++i)
+		{
+			for (int j = i + 1; j < ids; ++j)
+			{
+				if (!tracker.contains(i) || !tracker.contains(j))
+					continue;
+				const Structures::Time x = tracker.getTime(i);
+				const Structures::Time y = tracker.getTime(j);
+				const bool overlap = x.layer == y.layer && x.start < y.end && y.start < x.end;
+				ASSERT_EQ(tracker.collides(i, j), overlap) << "round " << round << " pair " << i << "," << j;
+				expected += overlap;
+			}
+		}
+		ASSERT_EQ(tracker.count(), expected) << "round " << round;
+	}
+}
+
+TEST(SRTGetCollisionsTest, ParallelMatchesSequential)
+{
+	SRT srt;
+	unsigned state = 777;
+	for (int i = 0; i < 500; ++i)
+	{
+		state = state * 1103515245u + 12345u;
+		const int start = (int)(state % 600000);
+		srt.getContents().push_back({ { 0, start, start + 1000 + (int)((state >> 8) % 20000) }, to_string(i) });
+	}
+
+	DynamicArray< Structures::Node > sequential = srt.getCollisions();
+	DynamicArray< Structures::Node > parallel = srt.getCollisionsParallel(4);
+
+	ASSERT_EQ(parallel.size(), sequential.size());
+	for (int i = 0; i < sequential.size(); ++i)
+	{
+		EXPECT_EQ(parallel[i].dialogue, sequential[i].dialogue);
+	}
+}
+
+TEST(SSAGetCollisionsTest, ParallelRespectsLayers)
+{
+	SSA ssa;
+	ssa.getContents().push_back({ { 1, 1000, 5000 }, "A" });
+	ssa.getContents().push_back({ { 1, 4000, 6000 }, "B" });
+	ssa.getContents().push_back({ { 2, 2000, 3000 }, "C" });
+	ssa.getContents().push_back({ { 1, 0, 90000 }, "D" });
+
+	DynamicArray< Structures::Node > sequential = ssa.getCollisions();
+	DynamicArray< Structures::Node > parallel = ssa.getCollisionsParallel(3);
+
+	ASSERT_EQ(parallel.size(), 6);
+	ASSERT_EQ(parallel.size(), sequential.size());
+	for (int i = 0; i < sequential.size(); ++i)
+	{
+		EXPECT_EQ(parallel[i].dialogue, sequential[i].dialogue);
+	}
+}
+
+TEST(SubtitleMergeTest, MergesTracksByStartTime)
+{
+	SRT dialogue;
+	dialogue.getContents().push_back({ { 0, 1000, 2000 }, "D1" });
+	dialogue.getContents().push_back({ { 0, 5000, 6000 }, "D2" });
+
+	SSA signs;
+	signs.getContents().push_back({ { 2, 1000, 9000 }, "S1" });
+	signs.getContents().push_back({ { 1, 3000, 4000 }, "S2" });
+
+	TTML forced;
+	forced.getContents().push_back({ { 0, 7000, 8000 }, "F2" });
+	forced.getContents().push_back({ { 0, 500, 800 }, "F1" });
+
+	SSA combined;
+	combined.merge({ &dialogue, &signs, &forced });
+
+	const char* expected[] = { "F1", "D1", "S1", "S2", "D2", "F2" };
+	ASSERT_EQ(combined.getContents().size(), 6);
+	for (int i = 0; i < 6; ++i)
+	{
+		EXPECT_EQ(combined.getContents()[i].dialogue, expected[i]);
+	}
+	EXPECT_EQ(combined.getContents()[2].time.layer, 2);
+	EXPECT_EQ(combined.getContents()[3].time.layer, 1);
+}
+
+TEST(SubtitleMergeTest, MergesItsOwnCuesAndToleratesItselfAsASource)
+{
+	SSA track;
+	istringstream in("[V4+ Styles]\nStyle: Sign,Arial\n\n[Events]\n"
+					 "Dialogue: 0,0:00:01.00,0:00:02.00,Sign,Bob,0,0,0,,T1\n"
+					 "Dialogue: 0,0:00:05.00,0:00:06.00,Sign,Bob,0,0,0,,T2\n");
+	track.fileParse(in);
+	SRT other;
+	for (int i = 0; i < 200; ++i)
+		other.getContents().push_back({ { 0, 3000 + i * 10, 4000 }, "O" });
+
+	// Self-aliasing: the growing array must not be the one read from.
+	track.merge({ &track, &other, &track });
+	ASSERT_EQ(track.getContents().size(), 202);
+	EXPECT_EQ(track.getContents()[0].dialogue, "T1");
+	EXPECT_EQ(track.getContents()[1].dialogue, "O");
+	EXPECT_EQ(track.getContents()[201].dialogue, "T2");
+	EXPECT_EQ(track.getStyles().styles.name(track.getContents()[201].style), "Sign");
+	EXPECT_EQ(track.getStyles().actors.name(track.getContents()[201].actor), "Bob");
+	EXPECT_EQ(track.getStyles().styles.name(track.getContents()[100].style), "Default");
+}
+
+TEST(SubtitleNormalizeTest, SortsByStartEndLayer)
+{
+	SSA ssa;
+	ssa.getContents().push_back({ { 1, 5000, 6000 }, "E" });
+	ssa.getContents().push_back({ { 0, 1000, 3000 }, "B" });
+	ssa.getContents().push_back({ { 2, 1000, 2000 }, "A" });
+	ssa.getContents().push_back({ { 1, 1000, 3000 }, "D" });
+	ssa.getContents().push_back({ { 0, 1000, 3000 }, "C" });
+	ssa.getContents().push_back({ { 0, -500, 100 }, "Z" });
+
+	ssa.normalize();
+
+	const char* expected[] = { "Z", "A", "B", "C", "D", "E" };
+	ASSERT_EQ(ssa.getContents().size(), 6);
+	for (int i = 0; i < 6; ++i)
+	{
+		EXPECT_EQ(ssa.getContents()[i].dialogue, expected[i]);
+	}
+}
+
+TEST(SubtitleNormalizeTest, MatchesStableSort)
+{
+	SRT srt;
+	unsigned state = 99;
+	for (int i = 0; i < 2000; ++i)
+	{
+		state = state * 1103515245u + 12345u;
+		const int start = (int)(state % 50000);
+		srt.getContents().push_back({ { 0, start, start + (int)((state >> 8) % 7) }, to_string(i) });
+	}
+	std::vector< Structures::Node > expected(srt.getContents().begin(), srt.getContents().end());
+	std::stable_sort(expected.begin(), expected.end(), [](const Structures::Node &a, const Structures::Node &b) {
+		return a.time.start < b.time.start || (a.time.start == b.time.start && a.time.end < b.time.end);
+	});
+
+	srt.normalize();
+
+	for (int i = 0; i < srt.getContents().size(); ++i)
+	{
+		EXPECT_EQ(srt.getContents()[i].dialogue, expected[i].dialogue);
+	}
+}
+
+TEST(SRTFileParseTest, InterningSharesRepeatedLines)
+{
+	std::string srtData;
+	for (int i = 1; i <= 4; ++i)
+		srtData += to_string(i) + "\n00:00:0" + to_string(i) + ",000 --> 00:00:0" + to_string(i) + ",500\n" +
+				   (i % 2 ? "[CROWD CHEERING]" : "Goal for the home side") + "\n\n";
+
+	std::istringstream iss(srtData);
+	SRT srt;
+	srt.setInterning(true);
+	srt.fileParse(iss);
+
+	ASSERT_EQ(srt.getContents().size(), 4);
+	EXPECT_TRUE(srt.getContents()[0].dialogue.shares(srt.getContents()[2].dialogue));
+	EXPECT_TRUE(srt.getContents()[1].dialogue.shares(srt.getContents()[3].dialogue));
+	EXPECT_FALSE(srt.getContents()[0].dialogue.shares(srt.getContents()[1].dialogue));
+	EXPECT_EQ(srt.getContents()[2].dialogue, "[CROWD CHEERING]");
+
+	std::istringstream again(srtData);
+	SRT plain;
+	plain.fileParse(again);
+	EXPECT_FALSE(plain.getContents()[0].dialogue.shares(plain.getContents()[2].dialogue));
+	EXPECT_EQ(plain.getContents()[0].dialogue, plain.getContents()[2].dialogue);
+}
+
+TEST(TextPoolTest, InternsByContent)
+{
+	Structures::TextPool pool;
+	Structures::Text a = pool.intern(std::string("speaker: "));
+	for (int i = 0; i < 200; ++i)
+		pool.intern(to_string(i));
+	Structures::Text b = pool.intern("speaker: ", 9);
+
+	EXPECT_TRUE(a.shares(b));
+	EXPECT_EQ(pool.size(), 201);
+	EXPECT_TRUE(pool.intern("", 0).empty());
+}
+
 TEST(SRTSetFormatTest, WrapsDialogueWithFormatting)
 {
 	SRT srt;
@@ -352,6 +876,78 @@ TEST(SSAGetCollisionsTest, FindsCollidingSubtitles)
 	EXPECT_EQ(collisions[1].dialogue, "B");
 }
 
+TEST(SSAFileParseTest, KeepsStylesAndActors)
+{
+	std::string assData =
+		"[Script Info]\n"
+		"ScriptType: v4.00+\n"
+		"\n"
+		"[V4+ Styles]\n"
+		"Format: Name, Fontname, Fontsize\n"
+		"Style: Default,Arial,20\n"
+		"Style: Signs,Verdana,28\n"
+		"\n"
+		"[Events]\n"
+		"Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n"
+		"Dialogue: 0,0:00:01.00,0:00:02.00,Signs,,0,0,0,,Exit\n"
+		"Dialogue: 1,0:00:03.00,0:00:04.00,Default,Anna,0,0,0,,Hello\n"
+		"Dialogue: 0,0:00:05.00,0:00:06.00,Signs,Anna,0,0,0,,Stop\n";
+
+	std::istringstream iss(assData);
+	SSA ssa;
+	ssa.fileParse(iss);
+
+	const Structures::StyleSheet &styles = ssa.getStyles();
+	ASSERT_EQ(ssa.getContents().size(), 3);
+	EXPECT_EQ(styles.styles.size(), 2);
+	EXPECT_EQ(ssa.getContents()[0].style, ssa.getContents()[2].style);
+	EXPECT_EQ(styles.styles.name(ssa.getContents()[0].style), "Signs");
+	EXPECT_EQ(ssa.getContents()[1].style, 0);
+	EXPECT_EQ(styles.actors.name(ssa.getContents()[1].actor), "Anna");
+	EXPECT_EQ(ssa.getContents()[1].actor, ssa.getContents()[2].actor);
+
+	toSSA writer;
+	ostringstream out;
+	writer.write(out, ssa.getContents(), styles);
+	EXPECT_NE(out.str().find("Style: Signs,Verdana,28\n"), string::npos);
+	EXPECT_NE(out.str().find("Dialogue: 1,00:00:03.000,00:00:04.000,Default,Anna,0,0,0,,Hello\n"), string::npos);
+
+	std::istringstream again(out.str());
+	SSA reparsed;
+	reparsed.fileParse(again);
+	ASSERT_EQ(reparsed.getContents().size(), 3);
+	EXPECT_EQ(reparsed.getContents()[2].dialogue, "Stop");
+	EXPECT_EQ(reparsed.getStyles().styles.name(reparsed.getContents()[2].style), "Signs");
+	EXPECT_EQ(reparsed.getContents()[1].time.layer, 1);
+}
+
+TEST(SSAFileParseTest, RoundTripsScriptInfoMarginsAndEffects)
+{
+	const std::string script = "[Script Info]\n"
+							   "; Script generated by hand\n"
+							   "Title: My Show\n"
+							   "ScriptType: v4.00+\n"
+							   "PlayResX: 1920\n"
+							   "PlayResY: 1080\n"
+							   "WrapStyle: 0\n"
+							   "\n"
+							   "[V4+ Styles]\n"
+							   "Format: Name, Fontname, Fontsize\n"
+							   "Style: Default,Arial,20\n"
+							   "\n"
+							   "[Events]\n"
+							   "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n"
+							   "Dialogue: 0,00:00:01.000,00:00:02.000,Default,,10,20,30,Scroll up,Moving\n"
+							   "Dialogue: 0,00:00:03.000,00:00:04.000,Default,Anna,0,0,0,,Plain, with comma\n";
+	std::istringstream in(script);
+	SSA ssa;
+	ssa.fileParse(in);
+	ASSERT_EQ(ssa.getContents().size(), 2);
+	EXPECT_EQ(ssa.getContents()[1].layout, 0);
+
+	EXPECT_EQ(toSSA().writeToString(ssa.getContents(), ssa.getStyles()), script);
+}
+
 TEST(SSASetFormatTest, WrapsDialogueWithFormatting)
 {
 	SSA ssa;
@@ -392,6 +988,26 @@ TEST(SRTTimeParseTest, ParsesCorrectTime)
 	EXPECT_EQ(t.end, 5000);
 }
 
+TEST(SRTTimeParseTest, RoundTripsClocksPastNinetyNineHours)
+{
+	DynamicArray< Structures::Node > nodes = { { { 0, 360001000, 360002000 }, "Hundred" },
+											   { { 0, 2160000000LL, 2160000500LL }, "Six hundred" } };
+	const string written = toSRT().writeToString(nodes);
+	ASSERT_NE(written.find("100:00:01,000 --> 100:00:02,000"), string::npos);
+
+	SRT srt;
+	istringstream in(written);
+	srt.fileParse(in);
+	ASSERT_EQ(srt.getContents().size(), 2);
+	EXPECT_EQ(srt.getContents()[0].time.start, 360001000);
+	EXPECT_EQ(srt.getContents()[1].time.start, 2160000000LL);
+	EXPECT_EQ(srt.getContents()[1].time.end, 2160000500LL);
+
+	string vtt;
+	ASSERT_TRUE(Transcode::srtToVtt(written, vtt));
+	EXPECT_NE(vtt.find("600:00:00.000 --> 600:00:00.500"), string::npos);
+}
+
 TEST(SAMITimeParseTest, ParsesCorrectTime)
 {
 	SAMI sami;
@@ -430,6 +1046,37 @@ TEST(TimeTest, TimeConverterConvertsCorrectly)
 	EXPECT_EQ(result, 3723040);
 }
 
+TEST(TimeTest, ClockParseHandlesLayouts)
+{
+	Structures::Ticks ms = 0;
+	EXPECT_TRUE(Structures::Time::clockParse("01:02:03,456", 12, ms));
+	EXPECT_EQ(ms, 3723456);
+	EXPECT_TRUE(Structures::Time::clockParse("1:02:03.45", 10, ms));
+	EXPECT_EQ(ms, 3723450);
+	EXPECT_TRUE(Structures::Time::clockParse("123:00:00.5", 11, ms));
+	EXPECT_EQ(ms, 442800500);
+	EXPECT_FALSE(Structures::Time::clockParse("01:0a:03,456", 12, ms));
+	EXPECT_FALSE(Structures::Time::clockParse("01-02-03,456", 12, ms));
+	EXPECT_FALSE(Structures::Time::clockParse("01:02:03", 8, ms));
+}
+
+TEST(TimeTest, FromClocksBuildsTime)
+{
+	Structures::Time t = Structures::Time::fromClocks("00:00:12,345", 12, "00:01:00,001", 12, 2);
+	EXPECT_EQ(t.layer, 2);
+	EXPECT_EQ(t.start, 12345);
+	EXPECT_EQ(t.end, 60001);
+	EXPECT_TRUE(Structures::Time::fromClocks("bad", 3, "00:01:00,001", 12).isEmpty());
+}
+
+TEST(SSATimeParseTest, ParsesSingleDigitHours)
+{
+	SSA ssa;
+	Structures::Time t = ssa.timeParse("Dialogue: 0,0:01:30.50,0:01:32.00,Default,,0,0,0,,Text");
+	EXPECT_EQ(t.start, 90500);
+	EXPECT_EQ(t.end, 92000);
+}
+
 TEST(TimeTest, IsEmptyReturnsTrueIfZero)
 {
 	Structures::Time t;
@@ -489,6 +1136,177 @@ TEST(TTMLDeleteFormatTest, RemovesFormattingTags)
 	ASSERT_EQ(ttml.getContents()[0].dialogue, "Hello TTML");
 }
 
+TEST(LazyFormatTest, WritesSameOutputAsEagerFormatting)
+{
+	const vector< string > lines = { "<b>Bold</b> {\\an8}top", "plain", "<i\nunclosed>", "" };
+	SRT eager, lazy;
+	SSA eagerSSA, lazySSA;
+	lazy.setLazyFormat(true);
+	lazySSA.setLazyFormat(true);
+	for (const auto &line : lines)
+	{
+		Structures::Node node = { { 0, 1000, 2000 }, line };
+		eager.getContents().push_back(node);
+		lazy.getContents().push_back(node);
+		eagerSSA.getContents().push_back(node);
+		lazySSA.getContents().push_back(node);
+	}
+
+	eager.setFormat();
+	eager.deleteFormat();
+	eager.setFormat();
+	eager.setFormat();
+	lazy.setFormat();
+	lazy.deleteFormat();
+	lazy.setFormat();
+	lazy.setFormat();
+	eagerSSA.deleteFormat();
+	eagerSSA.setFormat();
+	lazySSA.deleteFormat();
+	lazySSA.setFormat();
+
+	EXPECT_EQ(lazy.getContents()[0].dialogue, "<b>Bold</b> {\\an8}top");
+	toSRT srt;
+	ostringstream expected, actual;
+	srt.write(expected, eager.getContents());
+	srt.write(actual, lazy.getContents(), lazy.getStyles(), lazy.getTransform());
+	EXPECT_EQ(actual.str(), expected.str());
+
+	toSSA ssa;
+	ostringstream expectedSSA, actualSSA;
+	ssa.write(expectedSSA, eagerSSA.getContents());
+	ssa.write(actualSSA, lazySSA.getContents(), lazySSA.getStyles(), lazySSA.getTransform());
+	EXPECT_EQ(actualSSA.str(), expectedSSA.str());
+
+	lazy.setLazyFormat(false);
+	for (int i = 0; i < eager.getContents().size(); ++i)
+	{
+		EXPECT_EQ(lazy.getContents()[i].dialogue, eager.getContents()[i].dialogue);
+	}
+	EXPECT_TRUE(lazy.getTransform().isIdentity());
+}
+
+TEST(PipelineTest, MatchesSequentialPasses)
+{
+	SRT sequential;
+	for (int i = 0; i < 20; ++i)
+	{
+		Structures::Node node = { { 0, i * 1000, i * 1000 + 800 }, i % 3 == 0 ? "<i></i>" : "<b>line</b>" };
+		sequential.getContents().push_back(node);
+	}
+	const DynamicArray< Structures::Node > original = sequential.getContents();
+
+	sequential.deleteFormat();
+	sequential.setFormat();
+	DynamicArray< Structures::Node > expected;
+	for (auto node : sequential.getContents())
+	{
+		node.time.start = (node.time.start + 500) * 2;
+		node.time.end = (node.time.end + 500) * 2;
+		const bool empty = node.dialogue == "<i></i>";
+		if (!empty && node.time.start < 30000 && 10000 < node.time.end)
+			expected.push_back(node);
+	}
+
+	Pipeline pipeline;
+	pipeline.strip(TextTransform::BracesAndTags).dropEmpty().wrap("<i>", "</i>").shift(500).scale(2).between(10000, 30000);
+
+	toSRT writer;
+	ostringstream sequentialOut, fusedOut;
+	writer.write(sequentialOut, expected);
+	writer.write(fusedOut, original, Structures::StyleSheet(), pipeline);
+	EXPECT_EQ(fusedOut.str(), sequentialOut.str());
+	EXPECT_EQ(fusedOut.str().substr(0, 2), "1\n");
+}
+
+TEST(PipelineTest, NestsWrapsInOrder)
+{
+	DynamicArray< Structures::Node > nodes = { { { 0, 1000, 2000 }, "x" } };
+	Pipeline pipeline;
+	pipeline.wrap("<i>", "</i>").wrap("<b>", "</b>");
+
+	ostringstream out;
+	toSRT().write(out, nodes, Structures::StyleSheet(), pipeline);
+	EXPECT_NE(out.str().find("\n<b><i>x</i></b>\n"), string::npos);
+
+	TextTransform transform;
+	transform.wrap("<i>", "</i>");
+	transform.wrap("<b>", "</b>");
+	EXPECT_EQ(transform.apply(Structures::Text("x")), "<b><i>x</i></b>");
+}
+
+TEST(PipelineTest, RangeFollowsLaterTimeOperations)
+{
+	DynamicArray< Structures::Node > nodes = { { { 0, 1000, 2000 }, "a" }, { { 0, 5000, 6000 }, "b" } };
+	Pipeline pipeline;
+	pipeline.between(0, 3000).shift(10000);
+
+	toTTML writer;
+	ostringstream out;
+	writer.write(out, nodes, Structures::StyleSheet(), pipeline);
+	EXPECT_NE(out.str().find("<p begin=\"00:00:11.000\" end=\"00:00:12.000\">a</p>"), string::npos);
+	EXPECT_EQ(out.str().find(">b<"), string::npos);
+	EXPECT_THROW(pipeline.scale(0), invalid_argument);
+}
+
+TEST(LazyFormatTest, StripsThroughEarlierWrapsLikeTheEagerPasses)
+{
+	// 'w' is setFormat and 'd' deleteFormat; unterminated tags pair up with the wrap tags.
+	const vector< string > lines = { "a<b", "x{y", "<i>done</i>", "c>d", "{\\an8", "" };
+	const char *formats[] = { ".srt", ".ass", ".smi", ".vtt", ".ttml" };
+	const char *sequences[] = { "wd", "wdw", "dwwd", "wwdd", "dw" };
+	for (const char *format : formats)
+	{
+		for (const char *sequence : sequences)
+		{
+			unique_ptr< Subtitle > eager = SubtitleFactory::create(format);
+			unique_ptr< Subtitle > lazy = SubtitleFactory::create(format);
+			lazy->setLazyFormat(true);
+			for (const auto &line : lines)
+			{
+				const Structures::Node node = { { 0, 1000, 2000 }, line };
+				eager->getContents().push_back(node);
+				lazy->getContents().push_back(node);
+			}
+			for (const char *step = sequence; *step; ++step)
+			{
+				for (Subtitle *sub : { eager.get(), lazy.get() })
+				{
+					if (*step == 'w')
+						sub->setFormat();
+					else
+						sub->deleteFormat();
+				}
+			}
+			for (int i = 0; i < eager->getContents().size(); ++i)
+			{
+				const Structures::Text &text = lazy->getContents()[i].dialogue;
+				const string expected = eager->getContents()[i].dialogue.str();
+				EXPECT_EQ(lazy->getTransform().apply(text), expected) << format << " " << sequence << " " << lines[i];
+				EXPECT_EQ(lazy->getTransform().length(text), expected.size());
+			}
+			lazy->setLazyFormat(false);
+			for (int i = 0; i < eager->getContents().size(); ++i)
+				EXPECT_EQ(lazy->getContents()[i].dialogue, eager->getContents()[i].dialogue);
+		}
+	}
+}
+
+TEST(LazyFormatTest, TTMLStripsMultilineTags)
+{
+	TTML eager, lazy;
+	lazy.setLazyFormat(true);
+	Structures::Node node = { { 0, 0, 0 }, "<span\nstyle=\"x\">Hi</span><>" };
+	eager.getContents().push_back(node);
+	lazy.getContents().push_back(node);
+
+	eager.deleteFormat();
+	lazy.deleteFormat();
+	lazy.setLazyFormat(false);
+
+	EXPECT_EQ(lazy.getContents()[0].dialogue, eager.getContents()[0].dialogue);
+}
+
 TEST(TimeTest, DefaultConstructor)
 {
 	Structures::Time t;
@@ -514,6 +1332,24 @@ TEST(TimeTest, TimeConverter)
 	EXPECT_EQ(result, 3723040);
 }
 
+TEST(TimeTest, TimeConverterKeepsMilliseconds)
+{
+	EXPECT_EQ(Structures::Time::timeConverter("00:00:12,345"), 12345);
+	EXPECT_THROW(Structures::Time::timeConverter("garbage"), std::invalid_argument);
+}
+
+TEST(TimeTest, LongStreamsDoNotWrap)
+{
+	const Structures::Ticks ms = Structures::Time::timeConverter("700:00:00.001");
+	EXPECT_EQ(ms, 2520000001LL);
+
+	toSRT writer;
+	DynamicArray< Structures::Node > nodes = { { { 0, ms, ms + 1000 }, "Late" } };
+	ostringstream out;
+	writer.write(out, nodes);
+	EXPECT_EQ(out.str(), "1\n700:00:00,001 --> 700:00:01,001\nLate\n\n");
+}
+
 TEST(NodeTest, DefaultConstructor)
 {
 	Structures::Node node;
@@ -535,6 +1371,592 @@ TEST(NodeTest, ParameterizedConstructor)
 	EXPECT_EQ(node.dialogue, dialogue);
 }
 
+TEST(ScannerTest, FindsBytesAndPatternsAcrossBlocks)
+{
+	std::string text(300, 'x');
+	text[5] = ',';
+	text[130] = ',';
+	text[299] = ',';
+	text.replace(200, 3, "-->");
+
+	EXPECT_EQ(Scanner::find(text.data(), text.size(), ','), 5u);
+	EXPECT_EQ(Scanner::find(text.data(), text.size(), '<'), text.size());
+	EXPECT_EQ(Scanner::find(text.data(), text.size(), "-->", 3), 200u);
+	EXPECT_EQ(Scanner::find(text, "-->", 3, 201), std::string::npos);
+	EXPECT_EQ(Scanner::count(text.data(), text.size(), ','), 3u);
+	EXPECT_EQ(Scanner::count(text.data(), text.size(), "-->", 3), 1u);
+	EXPECT_EQ(Scanner::count("aaaa", 4, "aa", 2), 2u);
+
+	DynamicArray< size_t > commas;
+	Scanner::findAll(text.data(), text.size(), ',', commas);
+	ASSERT_EQ(commas.size(), 3);
+	EXPECT_EQ(commas[1], 130u);
+	EXPECT_EQ(commas[2], 299u);
+}
+
+TEST(ScannerTest, LineCursorMatchesGetline)
+{
+	std::string text = "first\n\n";
+	text += std::string(100, 'a') + "\n" + std::string(70, 'b') + "\nlast";
+
+	std::istringstream iss(text);
+	Scanner::LineCursor lines(text);
+	std::string expected, actual;
+	while (getline(iss, expected))
+	{
+		ASSERT_TRUE(lines.next(actual));
+		EXPECT_EQ(actual, expected);
+	}
+	EXPECT_FALSE(lines.next(actual));
+}
+
+TEST(EncodingTest, DecodesUtf16WithBom)
+{
+	const std::string text = "1\n00:00:01,000 --> 00:00:02,000\nCaf\xC3\xA9 \xF0\x9F\x98\x80 and some longer ASCII text\n";
+	std::string le = "\xFF\xFE";
+	std::string be = "\xFE\xFF";
+	const std::u16string units = u"1\n00:00:01,000 --> 00:00:02,000\nCaf\u00E9 \U0001F600 and some longer ASCII text\n";
+	for (char16_t u : units)
+	{
+		le += (char)(u & 0xFF);
+		le += (char)(u >> 8);
+		be += (char)(u >> 8);
+		be += (char)(u & 0xFF);
+	}
+
+	EXPECT_EQ(Encoding::toUtf8(le), text);
+	EXPECT_EQ(Encoding::toUtf8(be), text);
+	EXPECT_EQ(Encoding::toUtf8(le.substr(2), Encoding::Charset::UTF16LE), text);
+	EXPECT_EQ(Encoding::toUtf8("\xEF\xBB\xBFplain"), "plain");
+}
+
+TEST(EncodingTest, DecodesCodePages)
+{
+	EXPECT_EQ(Encoding::toUtf8("\xB0\xA1\xB3\xAA", Encoding::Charset::CP949), "\xEA\xB0\x80\xEB\x82\x98");
+	EXPECT_EQ(Encoding::toUtf8("5 \x80", Encoding::Charset::CP1252), "5 \xE2\x82\xAC");
+	EXPECT_EQ(Encoding::toUtf8("\xC4\xE0", Encoding::Charset::CP1251), "\xD0\x94\xD0\xB0");
+}
+
+TEST(EncodingTest, DecodingStreamFeedsParser)
+{
+	std::string bytes;
+	for (int i = 0; i < 5000; ++i)
+		bytes += "1\n00:00:01,000 --> 00:00:02,000\nHello \xB0\xA1\n\n";
+
+	std::istringstream raw(bytes);
+	Encoding::DecodingStream decoded(raw, Encoding::Charset::CP949);
+	SRT srt;
+	srt.fileParse(decoded);
+
+	ASSERT_EQ(srt.getContents().size(), 5000);
+	EXPECT_EQ(srt.getContents()[4999].dialogue, "Hello \xEA\xB0\x80");
+}
+
+TEST(EncodingTest, ReadUtf8MatchesWholeBufferDecoding)
+{
+	// Spans several decoding chunks.
+	std::string bytes = "\xFF\xFE";
+	for (int i = 0; i < 50000; ++i)
+		bytes += i % 7 ? std::string("a\0", 2) : std::string("\xE9\0", 2);
+	std::istringstream raw(bytes);
+	EXPECT_EQ(Encoding::readUtf8(raw), Encoding::toUtf8(bytes));
+
+	std::istringstream empty("");
+	EXPECT_EQ(Encoding::readUtf8(empty), "");
+}
+
+namespace
+{
+string convert(const string &input, const string &from, const WriteBehavior &writer)
+{
+	unique_ptr< Subtitle > sub = SubtitleFactory::create(from);
+	sub->setInterning(from == ".ass");
+	sub->setLazyFormat(true);
+	istringstream in(input);
+	sub->fileParse(in);
+	sub->deleteFormat();
+	sub->normalize();
+	ostringstream out;
+	writer.write(out, sub->getContents(), sub->getStyles(), Pipeline(sub->getTransform()).shift(250));
+	return out.str() + to_string(sub->getCollisionsParallel(2).size());
+}
+}
+
+// Each conversion owns its Subtitle; writers and a finished Subtitle are shared read-only.
+namespace
+{
+string genericConversion(const string &input, const string &from, const string &to)
+{
+	unique_ptr< Subtitle > source = SubtitleFactory::create(from);
+	istringstream in(input);
+	source->fileParse(in);
+	source->normalize();
+	unique_ptr< WriteBehavior > writer = SubtitleFactory::find(to)->makeWriter();
+	return writer->writeToString(source->getContents(), source->getStyles());
+}
+}
+
+TEST(TranscodeTest, SRTToTTMLMatchesGenericPath)
+{
+	const string input = "1\n00:00:01,000 --> 00:00:02,000\nFirst <i>line</i>\nSecond line\n\n"
+						 "2\n00:00:02,500 --> 00:00:03,000\nKept\nlower case\nAlso kept\n\n"
+						 "3\n00:00:04,000 --> 00:00:05,000\nno capitals at all\n\n"
+						 "4\nnot a time\nText\n\n"
+						 "5\r\n01:02:03,004 --> 101:00:00,000\r\nWindows\r\n\r\n";
+	ASSERT_EQ(Transcode::find(SubtitleFactory::find(".srt"), SubtitleFactory::find(".ttml")), &Transcode::srtToTtml);
+	string direct;
+	ASSERT_TRUE(Transcode::srtToTtml(input, direct));
+	EXPECT_EQ(direct, genericConversion(input, ".srt", ".ttml"));
+
+	const string unsorted = "1\n00:00:05,000 --> 00:00:06,000\nLate\n\n2\n00:00:01,000 --> 00:00:02,000\nEarly\n\n";
+	EXPECT_FALSE(Transcode::srtToTtml(unsorted, direct));
+}
+
+TEST(TranscodeTest, SSAToSRTMatchesGenericPath)
+{
+	const string input = "[Script Info]\nTitle: Test\n\n[V4+ Styles]\n"
+						 "Format: Name, Fontname, Fontsize\nStyle: Default,Arial,20\n\n[Events]\n"
+						 "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n"
+						 "Dialogue: 0,0:00:01.00,0:00:02.00,Default,,0,0,0,,{\\b1}Bold{\\b0}, with comma\n"
+						 "Comment: 0,0:00:01.50,0:00:02.00,Default,,0,0,0,,ignored\n"
+						 "Dialogue: 1,0:00:01.00,0:00:02.00,Default,Actor,0,0,0,,Second layer\\Nline\n"
+						 "Dialogue: 0,0:00:03.00,0:00:04.00,Default,,0,0,0,,\n";
+	string direct;
+	ASSERT_TRUE(Transcode::ssaToSrt(input, direct));
+	EXPECT_EQ(direct, genericConversion(input, ".ass", ".srt"));
+	EXPECT_NE(direct.find("2\n00:00:01,000 --> 00:00:02,000\nSecond layer\\Nline\n"), string::npos);
+
+	const string marked = "[Events]\nDialogue: Marked=0,0:00:01.00,0:00:02.00,Default,,0,0,0,,Text\n";
+	EXPECT_FALSE(Transcode::ssaToSrt(marked, direct));
+	EXPECT_EQ(Transcode::find(SubtitleFactory::find(".srt"), SubtitleFactory::find(".smi")), nullptr);
+}
+
+TEST(VTTFileParseTest, SkipsHeaderNotesAndSettings)
+{
+	const string input = "WEBVTT - Title\nKind: captions\n\n"
+						 "STYLE\n::cue { color: red }\n\n"
+						 "NOTE a comment with --> inside\nmore\n\n"
+						 "intro\n00:01.000 --> 00:02.500 align:start position:10%\n<v Roger>Hello</v>\nthere\n\n"
+						 "01:00:00.000 --> 01:00:01.000\r\nCRLF line\r\n\r\n"
+						 "broken --> timing\nDropped\n\n";
+	VTT vtt;
+	istringstream in(input);
+	vtt.fileParse(in);
+	ASSERT_EQ(vtt.getContents().size(), 2);
+	EXPECT_EQ(vtt.getContents()[0].time.start, 1000);
+	EXPECT_EQ(vtt.getContents()[0].time.end, 2500);
+	EXPECT_EQ(vtt.getContents()[0].dialogue, "<v Roger>Hello</v>\nthere");
+	EXPECT_EQ(vtt.getContents()[1].time.start, 3600000);
+	EXPECT_EQ(vtt.getContents()[1].dialogue, "CRLF line");
+}
+
+TEST(VTTFileParseTest, JoinsMultiLineCRLFCuesWithNewlines)
+{
+	const string input = "WEBVTT\r\n\r\n00:01.000 --> 00:02.000\r\nFirst\r\nsecond\r\nthird\r\n\r\n"
+						 "00:03.000 --> 00:04.000\r\nOne line\r\n\r\n";
+	VTT vtt;
+	istringstream in(input);
+	vtt.fileParse(in);
+	ASSERT_EQ(vtt.getContents().size(), 2);
+	EXPECT_EQ(vtt.getContents()[0].dialogue, "First\nsecond\nthird");
+	EXPECT_EQ(vtt.getContents()[1].dialogue, "One line");
+
+	string direct;
+	ASSERT_TRUE(Transcode::vttToSrt(input, direct));
+	EXPECT_EQ(direct, "1\n00:00:01,000 --> 00:00:02,000\nFirst\nsecond\nthird\n\n"
+					  "2\n00:00:03,000 --> 00:00:04,000\nOne line\n\n");
+}
+
+TEST(VTTWriteTest, RoundTripsThroughTheRegistry)
+{
+	unique_ptr< Subtitle > vtt = SubtitleFactory::create(".vtt");
+	ASSERT_NE(vtt, nullptr);
+	EXPECT_EQ(SubtitleFactory::sniff("WEBVTT"), SubtitleFactory::find(".vtt"));
+	istringstream in("WEBVTT\n\n1\n00:00:01.000 --> 00:00:02.000\nOne\n\n00:00:03.000 --> 00:00:04.000\nTwo\nlines\n\n");
+	vtt->fileParse(in);
+	EXPECT_EQ(vtt->writeToString(), "WEBVTT\n\n00:00:01.000 --> 00:00:02.000\nOne\n\n00:00:03.000 --> 00:00:04.000\nTwo\nlines\n\n");
+}
+
+TEST(TranscodeTest, SRTAndVTTMatchGenericPath)
+{
+	const string srt = "1\n00:00:01,000 --> 00:00:02,000\nFirst <i>line</i>\nSecond line\n\n"
+					   "2\n00:00:02,500 --> 00:00:03,000\nKept\nlower case\n\n";
+	string direct;
+	ASSERT_EQ(Transcode::find(SubtitleFactory::find(".srt"), SubtitleFactory::find(".vtt")), &Transcode::srtToVtt);
+	ASSERT_TRUE(Transcode::srtToVtt(srt, direct));
+	EXPECT_EQ(direct, genericConversion(srt, ".srt", ".vtt"));
+
+	const string vtt = "WEBVTT\n\nNOTE skipped\n\nid\n00:01.000 --> 00:02.000 line:0\nHello\nworld\n\n"
+					   "00:00:02.000 --> 00:00:03.000\nAgain\n\n";
+	ASSERT_TRUE(Transcode::vttToSrt(vtt, direct));
+	EXPECT_EQ(direct, genericConversion(vtt, ".vtt", ".srt"));
+	EXPECT_EQ(direct.substr(0, 40), "1\n00:00:01,000 --> 00:00:02,000\nHello\nwo");
+}
+
+TEST(ConcurrencyTest, ConvertsManyFilesInParallel)
+{
+	const int files = 300;
+	vector< string > inputs, formats, expected;
+	const toSRT srt;
+	const toSSA ssa;
+	const toTTML ttml;
+	const WriteBehavior *writers[] = { &srt, &ssa, &ttml };
+	for (int f = 0; f < files; ++f)
+	{
+		string input;
+		const int kind = f % 3;
+		for (int i = 0; i < 40 + f % 7; ++i)
+		{
+			const string begin = "00:0" + to_string(i % 10) + ":" + to_string(10 + (i * 7 + f) % 50) + ".";
+			if (kind == 0)
+				input += to_string(i + 1) + "\n00:00:" + to_string(10 + i) + ",000 --> 00:00:" + to_string(11 + i) +
+						 ",500\n<i>Line " + to_string(f) + "</i>\n\n";
+			else if (kind == 1)
+				input += "Dialogue: " + to_string(i % 2) + "," + begin + "00," + begin + "90,Default,,0,0,0,,{\\b1}x" +
+						 to_string(i % 5) + "\n";
+			else
+				input += "<p begin=\"" + begin + "000\" end=\"" + begin + "900\"><span>t" + to_string(i) + "</span></p>\n";
+		}
+		inputs.push_back(input);
+		formats.push_back(kind == 0 ? ".srt" : kind == 1 ? ".ass" : ".ttml");
+	}
+	for (int f = 0; f < files; ++f)
+		expected.push_back(convert(inputs[f], formats[f], *writers[f % 3]));
+	ASSERT_NE(expected[0].find("\nLine 0\n"), string::npos);
+	ASSERT_NE(expected[1].find(",x1\n"), string::npos);
+	ASSERT_NE(expected[2].find(">t0</p>"), string::npos);
+
+	SRT shared;
+	istringstream sharedIn(inputs[0]);
+	shared.fileParse(sharedIn);
+	const Subtitle &sharedView = shared;
+	const string sharedExpected = convert(inputs[0], ".srt", srt);
+
+	vector< string > actual(files);
+	atomic< int > next(0);
+	atomic< int > sharedMismatches(0);
+	vector< thread > pool;
+	for (int t = 0; t < 8; ++t)
+	{
+		pool.emplace_back([&]() {
+			for (int f = next++; f < files; f = next++)
+			{
+				actual[f] = convert(inputs[f], formats[f], *writers[f % 3]);
+				ostringstream out;
+				srt.write(out, sharedView.getContents(), sharedView.getStyles(), Pipeline().strip(TextTransform::BracesAndTags).shift(250));
+				if (out.str() + to_string(sharedView.getCollisions().size()) != sharedExpected)
+					++sharedMismatches;
+			}
+		});
+	}
+	for (auto &worker : pool)
+		worker.join();
+
+	EXPECT_EQ(sharedMismatches.load(), 0);
+	for (int f = 0; f < files; ++f)
+		EXPECT_EQ(actual[f], expected[f]) << "file " << f;
+}
+
+TEST(SchedulerTest, RunsSpawnedTasksAndBalancesThem)
+{
+	WorkStealingScheduler scheduler(4);
+	atomic< int > done(0);
+	scheduler.submit([&]() {
+		for (int i = 0; i < 200; ++i)
+		{
+			scheduler.submit([&]() {
+				this_thread::sleep_for(chrono::microseconds(200));
+				++done;
+			});
+		}
+	});
+	scheduler.wait();
+
+	EXPECT_EQ(done.load(), 200);
+	size_t tasks = 0, steals = 0;
+	for (const auto &worker : scheduler.getStats())
+	{
+		tasks += worker.tasks;
+		steals += worker.steals;
+	}
+	EXPECT_EQ(tasks, 201u);
+	EXPECT_GT(steals, 0u);
+}
+
+TEST(SplitTest, ChunksParseLikeTheWholeDocument)
+{
+	string script = "[Script Info]\nScriptType: v4.00+\n\n[V4+ Styles]\nFormat: Name, Fontname\nStyle: Sign,Arial\n\n[Events]\n";
+	for (int i = 0; i < 60; ++i)
+		script += "Dialogue: 0,0:00:" + to_string(10 + i % 40) + ".00,0:01:00.00," + (i % 3 ? "Default" : "Sign") +
+				  ",Actor" + to_string(i % 4) + ",0,0,0,,Line " + to_string(i) + "\n";
+
+	SSA whole;
+	istringstream in(script);
+	whole.fileParse(in);
+	whole.normalize();
+
+	DynamicArray< string > chunks = whole.split(script, 64);
+	ASSERT_GT(chunks.size(), 3);
+	EXPECT_NE(chunks[0].find("Style: Sign"), string::npos);
+	vector< unique_ptr< SSA > > parts;
+	DynamicArray< const Subtitle * > sources;
+	string joined;
+	for (const auto &chunk : chunks)
+	{
+		joined += chunk;
+		parts.emplace_back(new SSA());
+		istringstream piece(chunk);
+		parts.back()->fileParse(piece);
+		sources.push_back(parts.back().get());
+	}
+	EXPECT_EQ(joined, script);
+
+	SSA merged;
+	merged.merge(sources);
+	merged.normalize();
+	toSSA writer;
+	ostringstream expected, actual;
+	writer.write(expected, whole.getContents(), whole.getStyles());
+	writer.write(actual, merged.getContents(), merged.getStyles());
+	EXPECT_EQ(actual.str(), expected.str());
+}
+
+TEST(SplitTest, SplitsCRLFDocumentsAtBlankLines)
+{
+	string srt, vtt = "WEBVTT\r\nKind: captions\r\n\r\n";
+	for (int i = 0; i < 40; ++i)
+	{
+		const string start = "00:00:" + to_string(10 + i);
+		srt += to_string(i + 1) + "\r\n" + start + ",000 --> 00:01:00,000\r\nLine " + to_string(i) + "\r\nTwo\r\n\r\n";
+		vtt += start + ".000 --> 00:01:00.000\r\nLine " + to_string(i) + "\r\nTwo\r\n\r\n";
+	}
+	const pair< string, string > documents[] = { { ".srt", srt }, { ".vtt", vtt } };
+	for (const auto &document : documents)
+	{
+		unique_ptr< Subtitle > whole = SubtitleFactory::create(document.first);
+		whole->bufferParse(document.second);
+		ASSERT_EQ(whole->getContents().size(), 40) << document.first;
+		EXPECT_EQ(whole->getContents()[39].dialogue, "Line 39\nTwo");
+
+		DynamicArray< string > chunks = whole->split(document.second, 256);
+		EXPECT_GT(chunks.size(), 4) << document.first;
+		vector< unique_ptr< Subtitle > > parts;
+		DynamicArray< const Subtitle * > sources;
+		for (const auto &chunk : chunks)
+		{
+			parts.push_back(SubtitleFactory::create(document.first));
+			parts.back()->bufferParse(chunk);
+			sources.push_back(parts.back().get());
+		}
+		unique_ptr< Subtitle > merged = SubtitleFactory::create(document.first);
+		merged->merge(sources);
+		EXPECT_EQ(merged->writeToString(), whole->writeToString()) << document.first;
+	}
+
+	string direct;
+	ASSERT_TRUE(Transcode::srtToVtt(srt, direct));
+	EXPECT_EQ(direct, genericConversion(srt, ".srt", ".vtt"));
+	ASSERT_TRUE(Transcode::vttToSrt(vtt, direct));
+	EXPECT_EQ(direct, genericConversion(vtt, ".vtt", ".srt"));
+}
+
+TEST(BatchConverterTest, ChunkedConversionMatchesSingleTask)
+{
+	{
+		ofstream srt("batch_input.srt");
+		for (int i = 0; i < 300; ++i)
+			srt << i + 1 << "\n00:00:" << 10 + i % 50 << ",000 --> 00:01:00,000\nLine " << i << "\n\n";
+	}
+	BatchConverter chunked(4, 512);
+	BatchConverter whole(2, 1 << 30, false);
+	EXPECT_EQ(chunked.convert({ { "batch_input.srt", "batch_chunked.ttml" }, { "missing.srt", "missing.ttml" } }), 1);
+	EXPECT_EQ(whole.convert({ { "batch_input.srt", "batch_whole.ttml" } }), 1);
+	ASSERT_EQ(chunked.getFailures().size(), 1u);
+	EXPECT_EQ(chunked.getFailures()[0], "missing.srt");
+
+	ostringstream a, b;
+	a << ifstream("batch_chunked.ttml").rdbuf();
+	b << ifstream("batch_whole.ttml").rdbuf();
+	EXPECT_NE(b.str().find(">Line 299</p>"), string::npos);
+	EXPECT_EQ(a.str(), b.str());
+	remove("batch_input.srt");
+	remove("batch_chunked.ttml");
+	remove("batch_whole.ttml");
+}
+
+TEST(BatchConverterTest, WritesRangesInOrderAndReportsWriteFailures)
+{
+	{
+		ofstream srt("batch_ranges.srt");
+		for (int i = 0; i < 500; ++i)
+			srt << i + 1 << "\n00:00:" << 10 + i % 50 << ",000 --> 00:01:00,000\nLine " << i << "\n\n";
+	}
+	const char *outputs[] = { "batch_ranges_out.srt", "batch_ranges_out.ass", "batch_ranges_out.vtt" };
+	for (const char *output : outputs)
+	{
+		BatchConverter chunked(4, 512);
+		BatchConverter whole(1, 1 << 30, false);
+		const string single = string("single_") + output;
+		EXPECT_EQ(chunked.convert({ { "batch_ranges.srt", output } }), 1) << output;
+		EXPECT_EQ(whole.convert({ { "batch_ranges.srt", single } }), 1) << output;
+		ostringstream a, b;
+		a << ifstream(output).rdbuf();
+		b << ifstream(single).rdbuf();
+		EXPECT_FALSE(b.str().empty());
+		EXPECT_EQ(a.str(), b.str()) << output;
+		remove(output);
+		remove(single.c_str());
+	}
+
+	BatchConverter failing(2, 512);
+	EXPECT_EQ(failing.convert({ { "batch_ranges.srt", "no_such_dir/out.srt" } }), 0);
+	ASSERT_EQ(failing.getFailures().size(), 1u);
+	EXPECT_EQ(failing.getFailures()[0], "batch_ranges.srt");
+	remove("batch_ranges.srt");
+}
+
+TEST(SegmenterTest, DuplicatesCuesAcrossBoundariesAndFillsGaps)
+{
+	DynamicArray< Structures::Node > nodes = { { { 0, 1000, 2000 }, "A" },
+											   { { 0, 5000, 7000 }, "B" },
+											   { { 0, 6000, 6000 }, "C" },
+											   { { 0, 20000, 21000 }, "D" } };
+	toVTT writer;
+	vector< string > segments;
+	Segmenter segmenter(writer, 6000, [&](size_t index, Structures::Ticks start, const string &document) {
+		EXPECT_EQ(index, segments.size());
+		EXPECT_EQ(start, (Structures::Ticks)index * 6000);
+		segments.push_back(document);
+	});
+	segmenter.push(nodes);
+	EXPECT_EQ(segmenter.finish(), 4u);
+
+	ASSERT_EQ(segments.size(), 4u);
+	EXPECT_NE(segments[0].find("\nA\n"), string::npos);
+	EXPECT_NE(segments[0].find("\nB\n"), string::npos);
+	EXPECT_EQ(segments[0].find("\nC\n"), string::npos);
+	EXPECT_NE(segments[1].find("\nB\n"), string::npos);
+	EXPECT_NE(segments[1].find("\nC\n"), string::npos);
+	EXPECT_EQ(segments[2], "WEBVTT\n\n");
+	EXPECT_NE(segments[3].find("00:00:20.000 --> 00:00:21.000\nD\n"), string::npos);
+
+	EXPECT_THROW(segmenter.push(Structures::Node({ 0, 1000, 2000 }, "late")), invalid_argument);
+	EXPECT_THROW(Segmenter(writer, 0, nullptr), invalid_argument);
+}
+
+TEST(SegmenterTest, WritesSegmentFilesAndPlaylist)
+{
+	DynamicArray< Structures::Node > nodes = { { { 0, 1000, 7000 }, "Long" } };
+	toTTML writer;
+	EXPECT_EQ(HLS::writeSegments(nodes, writer, 6000, "hls_test", ".ttml"), 2u);
+
+	ostringstream playlist, second;
+	playlist << ifstream("hls_test.m3u8").rdbuf();
+	second << ifstream("hls_test00001.ttml").rdbuf();
+	EXPECT_EQ(playlist.str(), "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:6\n#EXT-X-MEDIA-SEQUENCE:0\n"
+							  "#EXT-X-PLAYLIST-TYPE:VOD\n#EXTINF:6.000,\nhls_test00000.ttml\n"
+							  "#EXTINF:6.000,\nhls_test00001.ttml\n#EXT-X-ENDLIST\n");
+	EXPECT_NE(second.str().find(">Long</p>"), string::npos);
+	remove("hls_test.m3u8");
+	remove("hls_test00000.ttml");
+	remove("hls_test00001.ttml");
+}
+
+namespace
+{
+template < typename Base > struct ByteCountingParser : Base
+{
+	size_t parsed = 0;
+	void fileParse(istream &f) override
+	{
+		const string text = Subtitle::readAll(f);
+		parsed += text.size();
+		istringstream in(text);
+		Base::fileParse(in);
+	}
+};
+
+string clock(Structures::Ticks ms, char separator)
+{
+	char buffer[32];
+	return separator == ',' ? string(buffer, ClockStamp< ',' >::format(buffer, ms))
+							: string(buffer, ClockStamp< '.' >::format(buffer, ms));
+}
+
+// Cue i runs from i seconds for 800 ms, except cue 495, which lasts 15 seconds.
+Structures::Ticks rangeEnd(int i) { return i * 1000 + (i == 495 ? 15000 : 800); }
+
+vector< string > overlapping(const Subtitle &sub, Structures::Ticks from, Structures::Ticks to)
+{
+	vector< string > cues;
+	for (const auto &node : sub.getContents())
+	{
+		if (node.time.start < to && node.time.end > from)
+			cues.push_back(to_string(node.time.start) + "-" + to_string(node.time.end) + " " + node.dialogue.str());
+	}
+	return cues;
+}
+} // namespace
+
+TEST(RangeTest, SRTWindowMatchesFilteredFullParse)
+{
+	string input;
+	for (int i = 0; i < 2000; ++i)
+		input += to_string(i + 1) + "\n" + clock(i * 1000, ',') + " --> " + clock(rangeEnd(i), ',') + "\nLine " +
+				 to_string(i) + "\n\n";
+	SRT whole;
+	istringstream in(input);
+	whole.fileParse(in);
+
+	ByteCountingParser< SRT > range;
+	EXPECT_TRUE(range.rangeParse(input.data(), input.size(), 500000, 520500));
+	const vector< string > expected = overlapping(whole, 500000, 520500);
+	ASSERT_EQ(expected.size(), 22u);
+	EXPECT_EQ(overlapping(range, 0, 1 << 30), expected);
+	EXPECT_EQ(expected.front(), "495000-510000 Line 495");
+	EXPECT_LT(range.parsed, input.size() / 10);
+
+	ByteCountingParser< SRT > none;
+	EXPECT_TRUE(none.rangeParse(input.data(), input.size(), 3000000, 4000000));
+	EXPECT_EQ(none.getContents().size(), 0);
+	EXPECT_EQ(none.parsed, 0u);
+}
+
+TEST(RangeTest, SSAWindowKeepsStylesAndSkipsOtherEvents)
+{
+	string input = "[Script Info]\nTitle: Test\n\n[V4+ Styles]\n"
+				   "Format: Name, Fontname, Fontsize\nStyle: Default,Arial,20\nStyle: Sign,Arial,30\n\n[Events]\n"
+				   "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n";
+	for (int i = 0; i < 2000; ++i)
+	{
+		if (i % 7 == 0)
+			input += "Comment: 0," + clock(i * 1000, '.') + "," + clock(i * 1000 + 500, '.') + ",Default,,0,0,0,,x\n";
+		input += "Dialogue: 0," + clock(i * 1000, '.') + "," + clock(rangeEnd(i), '.') + "," +
+				 (i % 2 ? "Sign" : "Default") + ",,0,0,0,,Line " + to_string(i) + "\n";
+	}
+	SSA whole;
+	istringstream in(input);
+	whole.fileParse(in);
+
+	ByteCountingParser< SSA > range;
+	EXPECT_TRUE(range.rangeParse(input.data(), input.size(), 500000, 520500));
+	EXPECT_EQ(overlapping(range, 0, 1 << 30), overlapping(whole, 500000, 520500));
+	EXPECT_EQ(range.getStyles().definitions.size(), whole.getStyles().definitions.size());
+	ASSERT_GT(range.getContents().size(), 0);
+	EXPECT_EQ(range.getStyles().styles.name(range.getContents()[0].style), "Sign");
+	EXPECT_LT(range.parsed, input.size() / 10);
+}
+
+TEST(RangeTest, OtherFormatsParseEverythingAndFilter)
+{
+	DynamicArray< Structures::Node > nodes = { { { 0, 1000, 2000 }, "A" }, { { 0, 3000, 4000 }, "B" } };
+	const string input = toTTML().writeToString(nodes, Structures::StyleSheet(), Pipeline());
+	TTML ttml;
+	EXPECT_FALSE(ttml.rangeParse(input.data(), input.size(), 2500, 5000));
+	ASSERT_EQ(ttml.getContents().size(), 1);
+	EXPECT_EQ(ttml.getContents()[0].dialogue, "B");
+}
+
 TEST(DynamicArrayTest, DefaultConstructor_Size)
 {
 	DynamicArray< int > arr;
@@ -648,6 +2070,134 @@ TEST(DynamicArrayTest, BeginEnd_IterationSum)
 	EXPECT_EQ(sum, 600);
 }
 
+namespace
+{
+class CountingAllocator : public Allocator
+{
+  public:
+	int live = 0;
+	int calls = 0;
+
+	void *allocate(size_t bytes, size_t alignment) override
+	{
+		++live;
+		++calls;
+		return Allocator::standard()->allocate(bytes, alignment);
+	}
+	void deallocate(void *p, size_t bytes, size_t alignment) override
+	{
+		--live;
+		Allocator::standard()->deallocate(p, bytes, alignment);
+	}
+};
+}
+
+TEST(DynamicArrayTest, UsesAndKeepsItsAllocator)
+{
+	CountingAllocator counting;
+	{
+		DynamicArray< string > arr(&counting);
+		for (int i = 0; i < 100; ++i)
+			arr.push_back(string(40, 'a' + i % 26));
+		arr.push_back(arr[0]);
+		EXPECT_EQ(arr[100], arr[0]);
+
+		DynamicArray< string > copy = arr;
+		EXPECT_EQ(copy.getAllocator(), Allocator::standard());
+		EXPECT_EQ(copy[99], arr[99]);
+
+		arr = DynamicArray< string >{ "x", "y" };
+		EXPECT_EQ(arr.getAllocator(), &counting);
+		ASSERT_EQ(arr.size(), 2);
+		EXPECT_EQ(arr[1], "y");
+	}
+	EXPECT_EQ(counting.live, 0);
+}
+
+TEST(AllocatorTest, DocumentArenaTakesAFewBlocks)
+{
+	string input;
+	for (int i = 0; i < 20000; ++i)
+		input += to_string(i + 1) + "\n00:00:01,000 --> 00:00:02,000\nLine\n\n";
+	SRT srt;
+	istringstream in(input);
+	srt.fileParse(in);
+
+	ASSERT_EQ(srt.getContents().size(), 20000);
+	EXPECT_EQ(srt.getContents().getAllocator(), &srt.getArena());
+	EXPECT_LT(srt.getArena().blockCount(), 16u);
+}
+
+TEST(AllocatorTest, DialogueLivesInTheArenaAndOutlivesTheDocument)
+{
+	string input;
+	for (int i = 0; i < 1000; ++i)
+		input += to_string(i + 1) + "\n00:00:01,000 --> 00:00:02,000\nA line long enough to leave SSO " + to_string(i) + "\n\n";
+	Structures::Node kept;
+	size_t before = 0;
+	{
+		SRT srt;
+		istringstream in(input);
+		srt.fileParse(in);
+		before = srt.getArena().bytesReserved();
+		kept = srt.getContents()[999];
+		EXPECT_GT(before, 1000 * kept.dialogue.size());
+		EXPECT_LT(srt.getArena().blockCount(), 12u);
+	}
+	EXPECT_EQ(kept.dialogue, "A line long enough to leave SSO 999");
+}
+
+TEST(AllocatorTest, AppendParseKeepsArenaLinear)
+{
+	SRT srt;
+	size_t afterQuarter = 0;
+	for (int i = 0; i < 8000; ++i)
+	{
+		srt.appendParse(to_string(i + 1) + "\n00:00:01,000 --> 00:00:02,000\nLine\n\n");
+		if (i + 1 == 2000)
+			afterQuarter = srt.getArena().bytesReserved();
+	}
+	srt.finishParse();
+
+	ASSERT_EQ(srt.getContents().size(), 8000);
+	EXPECT_LT(srt.getArena().bytesReserved(), 16 * 8000 * sizeof(Structures::Node));
+	EXPECT_LT(srt.getArena().bytesReserved(), 8 * afterQuarter);
+}
+
+TEST(AllocatorTest, PoolReusesFreedBlocks)
+{
+	CountingAllocator counting;
+	PoolAllocator pool(&counting);
+	for (int round = 0; round < 10; ++round)
+	{
+		DynamicArray< Structures::Node > collisions(&pool);
+		for (int i = 0; i < 5000; ++i)
+			collisions.push_back(Structures::Node({ 0, i, i + 1 }, ""));
+	}
+	const int afterRounds = counting.calls;
+	DynamicArray< Structures::Node > again(&pool);
+	for (int i = 0; i < 5000; ++i)
+		again.push_back(Structures::Node({ 0, i, i + 1 }, ""));
+	EXPECT_EQ(counting.calls, afterRounds);
+	EXPECT_LT(afterRounds, 16);
+}
+
+TEST(AllocatorTest, PreScanReservesEveryNodeAtOnce)
+{
+	string input;
+	for (int i = 0; i < 5000; ++i)
+		input += to_string(i + 1) + "\n00:00:01,000 --> 00:00:02,000\nLine " + to_string(i % 50) + "\n\n";
+	SRT srt;
+	srt.setInterning(true);
+	istringstream in(input);
+	srt.fileParse(in);
+
+	ASSERT_EQ(srt.getContents().size(), 5000);
+	EXPECT_EQ(srt.getContents().capacity(), 5000);
+	EXPECT_EQ(srt.getContents()[4999].dialogue, "Line 49");
+	EXPECT_TRUE(srt.getContents()[0].dialogue.shares(srt.getContents()[50].dialogue));
+}
+
 int main(int argc, char **argv)
 {
 	testing::InitGoogleTest(&argc, argv);